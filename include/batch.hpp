@@ -0,0 +1,15 @@
+#ifndef BATCH_HPP_INCLUDE
+#define BATCH_HPP_INCLUDE
+
+#include <filesystem>
+
+/// @brief Offline static evaluation of FEN files, run with `Engine evalfile <in> <out> [threads]`.
+namespace batch {
+    /// @brief Evaluates every line of in, a FEN or EPD position followed by anything, and writes one line
+    /// per input line to out: the static evaluation in centipawns from white's view, or "invalid".
+    /// The file is streamed in chunks whose lines are split between the threads.
+    /// @return false if a file cannot be opened or written.
+    bool eval_file(const std::filesystem::path& in, const std::filesystem::path& out, int threads);
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef BITBASE_HPP_INCLUDE
+#define BITBASE_HPP_INCLUDE
+
+#include "globals.hpp"
+
+/// @brief King and pawn against king win/draw bitbase, built by retrograde analysis.
+/// Positions are stored with the pawn side as white and the pawn on files a-d,
+/// 2 sides * 24 pawn squares * 64 * 64 king squares = 196608 bits (24 KB).
+namespace bitbase {
+    /// @brief Builds the bitbase, later calls return immediately.
+    void init();
+
+    /// @brief Whether strong wins, with squares given from white's view.
+    /// @param strong Side with the pawn.
+    /// @param stm Side to move.
+    bool probe_kpk(Square strong_king, Square pawn, Square weak_king, Colour strong, Colour stm);
+}
+
+#endif
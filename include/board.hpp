@@ -1,16 +1,25 @@
 #ifndef BOARD_HPP_INCLUDE
 #define BOARD_HPP_INCLUDE
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <string>
+#include <string_view>
 #include <array>
 #include <vector>
+#include <span>
 
 #include "move_gen.hpp"
 #include "globals.hpp"
+#include "pawn_hash.hpp"
+#include "bitbase.hpp"
+#include "nnue.hpp"
 
 class Board;
 extern Board game_board;
+struct AttackInfo;
+struct EvalTrace;
 
 /// @brief Castling rights encoder.
 using CastlingRights = int;
@@ -64,11 +73,17 @@ inline bool is_move_capture(Move move) {
 /// @brief Square helper.
 /// @param sq The square to flip.
 /// @return The reflected square across the rank axis.
-inline Square flip_rank(Square sq) { return sq ^ 56; }
+inline constexpr Square flip_rank(Square sq) { return sq ^ 56; }
 
 inline int get_file(Square sq) { return sq & 7; }
 inline int get_rank(Square sq) { return sq >> 3; }
 
+/// @brief Square helper.
+/// @return The number of king moves between sq1 and sq2.
+inline int distance(Square sq1, Square sq2) {
+    return std::max(std::abs(get_file(sq1) - get_file(sq2)), std::abs(get_rank(sq1) - get_rank(sq2)));
+}
+
 /// @brief Colour helper.
 /// @param friendly_colour Colour to get the opposite of.
 /// @return The opposite colour to friendly_colour, no_colour if friendly_colour is no_colour.
@@ -119,8 +134,15 @@ struct BoardState {
     int halfmove_clock;
     int fullmove_counter;
     Key hash_key;
+    Key pawn_key; // Zobrist key of the pawns only, indexes the pawn hash.
+    Key material_key; // Zobrist key of the piece counts, indexes the material table.
     MoveList move_list;
+    PhaseScore psqt; // Material and PSQT sums, kept up to date by make_move.
+    int phase = 0; // Non-pawn material phase, MAX_PHASE at the start. Promotions can exceed it.
     bool is_in_check = 0;
+    BB checkers = 0; // Opponent pieces giving check to the side to move.
+    std::array<BB, 2> blockers{}; // Pieces of either colour shielding the king of [colour] from a slider.
+    std::array<BB, 6> check_squares{}; // Squares from which each piece type of the side to move gives check.
     void reset();
 };
 
@@ -129,9 +151,24 @@ namespace zobrist {
     inline std::array<Key, 4> castling_keys;
     inline std::array<Key, 8> ep_file_key;
     inline Key side_key;
+    inline Key no_pawns_key; // Keeps pawn keys non-zero, so empty pawn hash slots never match.
 
     void init_keys();
     Key gen_pos_key(BoardState& state);
+    Key gen_pawn_key(BoardState& state);
+    Key gen_material_key(BoardState& state);
+}
+
+/// @brief Cuckoo tables of reversible moves, used to detect upcoming repetitions.
+/// See http://web.archive.org/web/20201107002606/https://marcelk.net/2013-04-06/paper/upcoming-rep-v2.pdf.
+namespace cuckoo {
+    inline std::array<Key, 8192> keys; // piece_key[from] ^ piece_key[to] ^ side_key
+    inline std::array<Move, 8192> moves;
+
+    inline int h1(Key key) { return key & 0x1fff; }
+    inline int h2(Key key) { return (key >> 16) & 0x1fff; }
+
+    void init();
 }
 
 #define UNUSED -1
@@ -163,6 +200,8 @@ private:
     // std::vector<BoardState> prev_states;
     std::array<BoardState, max_ply+1> prev_states;
     size_t prev_state_idx = 0;
+    std::array<nnue::Accumulator, max_ply+1> accumulators; // Parallel to prev_states, one per position of the search path.
+    std::vector<Key> key_history; // Keys of every position before the current one, game and search path.
     std::array<int, max_ply> pv_length = { 0 };
     void update_pv(int ply, int pv_idx, int next_pv_idx);
     Move generate_move_nopromo(Square from_sq, Square to_sq);
@@ -171,69 +210,121 @@ private:
     Score search_root(int depth, Score alpha, Score beta);
     bool is_search_stopped(int ply);
     void order_moves(Move hash_move, int ply);
-    Score eval_pawns();
-    Score eval_knights();
-    Score eval_bishops();
-    Score eval_rooks();
-    Score eval_queens();
-    Score eval_kings();
-    BB sq_attacked_by(BB occ, Square sq);
     BB get_attacked_BB(Colour side);
+    BB slider_blockers(Square king_sq, BB rooks, BB bishops);
+    template <Colour US>
+    void update_check_info();
+    void update_accumulator(Colour perspective);
     BB get_least_valuable_piece(BB attackdef, Colour side, Piece& piece);
+
+    /// @brief Builds the move, key and bitbase tables on first use, once for every thread.
+    static void init_tables();
 public:
     SearchParams search_params;
     BoardState state;
     std::array<Move, PV_TABLE_SIZE> pv_table = { nullmove };
 
     Board() {
-        move_generator::init_sliding_move_tables();
-        zobrist::init_keys();
+        init_tables();
         state.reset();
         prev_states[prev_state_idx] = state;
     }
 
     Board(std::string fen) {
-        move_generator::init_sliding_move_tables();
-        zobrist::init_keys();
+        init_tables();
         load_fen(fen);
         prev_states[prev_state_idx] = state;
     }
 
     Board(const char *fen) {
-        move_generator::init_sliding_move_tables();
-        zobrist::init_keys();
+        init_tables();
         load_fen(fen);
         prev_states[prev_state_idx] = state;
     }
 
     Board(bool load_start) {
         if (!load_start) return;
-        move_generator::init_sliding_move_tables();
-        zobrist::init_keys();
+        init_tables();
         load_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
         prev_states[prev_state_idx] = state;
     }
 
+    /// @brief Drops the unmake history, the key history is kept for repetition detection.
     void reset_state_list() {
         prev_states[0] = state;
+        accumulators[0] = accumulators[prev_state_idx];
         prev_state_idx = 0;
     }
 
-    void load_fen(std::string fen);
+    /// @brief Sets up a position without allocating. The move counters are optional, as in EPD,
+    /// and anything after the last field is ignored.
+    /// @return false if the FEN is malformed or a side has no king or several, the state is then unusable.
+    bool load_fen(std::string_view fen);
+
+    /// @brief Sets up a position without castling rights or en passant square.
+    /// @param pieces Piece on each of squares.
+    /// @param stm Side to move.
+    void load_pieces(std::span<const Piece> pieces, std::span<const Square> squares, Colour stm);
+
+    /// @brief Recomputes the derived bitboards, keys, PSQT and check info from the piece bitboards.
+    void refresh_state();
     void print_board();
 
+    /// @brief Generates legal moves for the side to move into state.move_list.
     template <bool GEN_CAPTURES>
     [[gnu::hot]]
+    void generate_moves() {
+        if (state.side_to_move == white) generate_moves<white, GEN_CAPTURES>();
+        else generate_moves<black, GEN_CAPTURES>();
+    }
+
+    template <Colour US, bool GEN_CAPTURES>
+    [[gnu::hot]]
     void generate_moves();
     bool is_side_in_check(Colour side);
+
+    /// @brief Tests if a legal move checks the opponent king, without making it.
+    /// @param move Encoded move for the side to move.
+    /// @return true if the move gives direct, discovered or special move check.
+    bool gives_check(Move move);
+    BB sq_attacked_by(BB occ, Square sq);
     void make_null_move();
     [[gnu::hot]]
+    void make_move(Move move) {
+        if (state.side_to_move == white) make_move<white>(move);
+        else make_move<black>(move);
+    }
+
+    template <Colour US>
+    [[gnu::hot]]
     void make_move(Move move);
     [[gnu::hot]]
     void unmake_last_move();
+    // Evaluation terms, each from white's view. Public for evalcost.
+    const PawnEntry& eval_pawns();
+    PhaseScore eval_rooks(const PawnEntry& pawn_entry);
+    PhaseScore eval_mobility(const AttackInfo& attacks);
+    PhaseScore eval_king_safety(const AttackInfo& attacks);
+    PhaseScore eval_threats(const AttackInfo& attacks);
+    PhaseScore eval_psqt();
+    int eval_phase();
+
+    /// @brief Evaluates the classical terms by colour for evaltrace.
+    EvalTrace trace_eval();
+
     Score eval();
+
+    /// @brief Network evaluation, updating the accumulators of the search path as needed.
+    /// @return Score from the side to move's view, known endgames are not special cased.
+    Score eval_nnue();
+
+    /// @brief Static evaluation through the eval cache.
+    Score probe_eval();
+    bool is_known_draw();
+    bool probe_bitbase(Score& score);
     void run_search();
-    bool is_rep();
+    bool is_rep(int ply);
+    bool is_upcoming_rep(int ply);
     void clean_search();
     Score see(Square to_sq, Piece target, Square from_sq, Piece att_piece);
 };
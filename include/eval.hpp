@@ -6,106 +6,75 @@
 #include "../include/board.hpp"
 #include "../include/bitboard_math.hpp"
 
-#define DBL_PAWNS_PEN -8
-#define TRI_PAWNS_PEN -10
-#define PASS_PAWNS_BONUS 17
-#define ISO_PAWNS_PEN -10
-#define HALF_ISO_PAWNS_PEN -4
-
-#define OPEN_FILE_ROOKS_BONUS 10
-#define HALF_OPEN_FILE_ROOKS_BONUS 5
-
-constexpr std::array<Score, 5> material = { 100, 320, 330, 500, 900 };
-
-constexpr std::array<std::array<Score, 64>, 2> pawn_psqt = {{
-    {
-         0,  0,  0,  0,  0,  0,  0,  0,
-        50, 50, 50, 50, 50, 50, 50, 50,
-        10, 10, 20, 30, 30, 20, 10, 10,
-         5,  5, 10, 25, 25, 10,  5,  5,
-         0,  0,  0, 20, 20,  0,  0,  0,
-         2, -5,-10, -5, -5, -7, -5,  2,
-         5, 10, 10,-20,-20, 10, 10,  5,
-         0,  0,  0,  0,  0,  0,  0,  0
-    },
-    {
-         0,  0,  0,  0,  0,  0,  0,  0,
-        80, 90, 90, 90, 90, 90, 90, 80,
-        70, 80, 80, 80, 80, 80, 80, 70,
-        60, 70, 70, 70, 70, 70, 70, 60,
-        55, 55, 55, 55, 55, 55, 55, 55,
-        50, 50, 50, 50, 50, 50, 50, 50,
-         0,  0,  0,  0,  0,  0,  0,  0,
-         0,  0,  0,  0,  0,  0,  0,  0
+/// @brief Game phase weight of each piece, indexed by piece. A full set of pieces gives MAX_PHASE.
+constexpr std::array<int, 12> phase_weights = { 0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0 };
+constexpr int MAX_PHASE = 24;
+
+/// @brief Tunable terms are constants, or variables the tuner can change when built with ENGINE_TUNE.
+#ifdef ENGINE_TUNE
+#define EVAL_PARAM inline
+#else
+#define EVAL_PARAM constexpr
+#endif
+
+#include "eval_params.hpp"
+
+/// @brief Combines the material and PSQT terms into psqt_values.
+constexpr std::array<std::array<PhaseScore, 64>, 12> make_psqt_values() {
+    std::array<std::array<PhaseScore, 64>, 12> arr{};
+    for (Square sq = 0; sq < 64; ++sq) {
+        for (Colour side : { black, white }) {
+            Square idx = side == white ? flip_rank(sq) : sq;
+            int sign = side == white ? 1 : -1;
+            Piece offset = side == white ? P : p;
+
+            arr[offset + p][sq] = { sign * (material[p] + pawn_psqt[0][idx]), sign * (material[p] + pawn_psqt[1][idx]) };
+            arr[offset + n][sq] = { sign * (material[n] + knight_psqt[idx]), sign * (material[n] + knight_psqt[idx]) };
+            arr[offset + b][sq] = { sign * (material[b] + bishop_psqt[idx]), sign * (material[b] + bishop_psqt[idx]) };
+            arr[offset + r][sq] = { sign * (material[r] + rook_psqt[idx]), sign * (material[r] + rook_psqt[idx]) };
+            arr[offset + q][sq] = { sign * (material[q] + queen_psqt[idx]), sign * (material[q] + queen_psqt[idx]) };
+            arr[offset + k][sq] = { sign * king_psqt[0][idx], sign * king_psqt[1][idx] };
+        }
     }
-}};
-
-constexpr std::array<Score, 64> knight_psqt = {
-    -50,-20,-30,-30,-30,-30,-20,-50,
-    -40,-20,  0,  0,  0,  0,-20,-40,
-    -30,  7, 13, 10, 10, 13,  7,-30,
-    -30,  2, 12, 17, 17, 12,  2,-30,
-    -30,  0, 12, 17, 17, 12,  0,-30,
-    -30,  7, 13, 10, 10, 13,  7,-30,
-    -40,-20,  0,  5,  5,  0,-20,-40,
-    -50,-20,-30,-30,-30,-30,-20,-50
-};
 
-constexpr std::array<Score, 64> bishop_psqt = {
-    -20,-10,-10,-10,-10,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5, 10, 10,  5,  0,-10,
-    -10,  5,  5, 10, 10,  5,  5,-10,
-    -10,  0, 12, 10, 10, 12,  0,-10,
-    -10, 10,  7, 12, 12,  7, 10,-10,
-    -10,  5,  0,  0,  0,  0,  5,-10,
-    -20,-10,-10,-10,-10,-10,-10,-20
-};
+    return arr;
+}
 
-constexpr std::array<Score, 64> rook_psqt = {
-    0,  0,  0,  0,  0,  0,  0,  0,
-    5, 10, 10, 10, 10, 10, 10,  5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    0,  0,   0,  5,  5,  0,  0,  0
-};
+/// @brief Material and PSQT of a piece on a square, positive for white. Indexed by [piece][square].
+/// Pawns and kings have separate middlegame and endgame tables, the other pieces share one table.
+alignas(64) EVAL_PARAM std::array<std::array<PhaseScore, 64>, 12> psqt_values = make_psqt_values();
 
-constexpr std::array<Score, 64> queen_psqt = {
-    -20,-10,-10, -5, -5,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5,  5,  5,  5,  0,-10,
-    -5,  0,  5,  5,  5,  5,  0, -5,
-        0,  0,  5,  5,  5,  5,  0, -5,
-    -10,  5,  5,  5,  5,  5,  0,-10,
-    -10,  0,  5,  0,  0,  0,  0,-10,
-    -20,-10,-10, -5, -5,-10,-10,-20
+/// @brief Attack maps of a position, built once per evaluation and read by the mobility, king safety and threat terms.
+struct AttackInfo {
+    std::array<BB, 12> by_piece{}; // Squares attacked by the pieces of each kind, indexed by piece.
+    std::array<BB, 2> by_side{}; // Indexed by colour.
+    std::array<std::array<int, 4>, 2> mobility{}; // Safe squares attacked by the knights, bishops, rooks and queens of a side.
+    std::array<int, 2> king_zone_attacks{}; // Attacks of a side's pieces on the other king and its neighbours.
 };
 
-constexpr std::array<std::array<Score, 64>, 2> king_psqt = {{
-    {
-        -30,-40,-40,-50,-50,-40,-40,-30,
-        -30,-40,-40,-50,-50,-40,-40,-30,
-        -30,-40,-40,-50,-50,-40,-40,-30,
-        -30,-40,-40,-50,-50,-40,-40,-30,
-        -20,-30,-30,-40,-40,-30,-30,-20,
-        -10,-20,-20,-20,-20,-20,-20,-10,
-        20, 20, -5, -5, -5, -5, 20, 20,
-        20, 30, 10,  0,  0,  7, 27, 17
-    },
-    {
-        -50,-40,-30,-20,-20,-30,-40,-50,
-        -30,-20,-10,  0,  0,-10,-20,-30,
-        -30,-10, 20, 30, 30, 20,-10,-30,
-        -30,-10, 30, 40, 40, 30,-10,-30,
-        -30,-10, 30, 40, 40, 30,-10,-30,
-        -30,-10, 20, 30, 30, 20,-10,-30,
-        -30,-30,  0,  0,  0,  0,-30,-30,
-        -50,-30,-30,-30,-30,-30,-30,-50
-    }
-}};
+/// @brief Builds the attack maps with one lookup per piece. Mobility leaves out squares of
+/// the side's own pieces and squares attacked by enemy pawns.
+AttackInfo compute_attacks(const BoardState& state);
+
+/// @brief Classical evaluation terms of a position by colour, each side's values from its own view.
+struct EvalTrace {
+    enum Term { MATERIAL, PSQT, PAWNS, ROOKS, MOBILITY, KING_SAFETY, THREATS, NUM_TERMS };
+    static constexpr std::array<const char*, NUM_TERMS> names = {
+        "material", "psqt", "pawns", "rooks", "mobility", "king_safety", "threats"
+    };
+
+    /// @brief What gives the score, checked in this order by Board::eval.
+    enum Source { DEAD_DRAW, ENDGAME_EVALUATOR, NETWORK, TERMS };
+    static constexpr std::array<const char*, 3> source_names = {
+        "a dead draw", "a known endgame evaluator", "the network"
+    };
+
+    std::array<std::array<PhaseScore, 2>, NUM_TERMS> terms{}; // Indexed by [term][colour].
+    int phase = 0; // Clamped to MAX_PHASE.
+    int scale = 0; // Endgame scale factor of the side ahead, SCALE_NORMAL is no scaling.
+    Source source = TERMS;
+    Score score = 0; // Board::eval from white's view.
+};
 
 
 
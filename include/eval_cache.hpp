@@ -0,0 +1,46 @@
+#ifndef EVAL_CACHE_HPP_INCLUDE
+#define EVAL_CACHE_HPP_INCLUDE
+
+#include <array>
+#include <cstddef>
+
+#include "globals.hpp"
+
+/// @brief Static evaluation of a position, from the side to move's view.
+struct EvalEntry {
+    Key key = 0;
+    Score score = 0;
+};
+
+constexpr size_t EVAL_CACHE_SIZE = 1 << 12; // Entries, must be a power of 2.
+
+/// @brief Direct mapped static evaluation cache, one per search thread.
+class EvalCache {
+private:
+    std::array<EvalEntry, EVAL_CACHE_SIZE> entries{};
+public:
+    long probes = 0;
+    long hits = 0;
+
+    /// @brief Finds the slot for key, the caller fills it on a miss.
+    /// @param key Zobrist key of the position.
+    /// @return The entry for key, its key differs from key on a miss.
+    EvalEntry& probe(Key key) {
+        probes++;
+        EvalEntry& entry = entries[key & (EVAL_CACHE_SIZE - 1)];
+        if (entry.key == key) hits++;
+        return entry;
+    }
+
+    /// @brief Drops every entry, needed when evaluation weights change.
+    void clear() { entries.fill(EvalEntry{}); }
+
+    void reset_stats() {
+        probes = 0;
+        hits = 0;
+    }
+};
+
+inline thread_local EvalCache eval_cache;
+
+#endif
@@ -12,6 +12,20 @@ using Move = uint16_t;
 using Code = int;
 using Score = int;
 
+/// @brief Middlegame and endgame pair of an evaluation term.
+struct PhaseScore {
+    Score mg = 0;
+    Score eg = 0;
+
+    constexpr PhaseScore& operator+=(PhaseScore other) { mg += other.mg; eg += other.eg; return *this; }
+    constexpr PhaseScore& operator-=(PhaseScore other) { mg -= other.mg; eg -= other.eg; return *this; }
+    constexpr PhaseScore operator+(PhaseScore other) const { return { mg + other.mg, eg + other.eg }; }
+    constexpr PhaseScore operator-(PhaseScore other) const { return { mg - other.mg, eg - other.eg }; }
+    constexpr PhaseScore operator-() const { return { -mg, -eg }; }
+    constexpr PhaseScore operator*(int n) const { return { mg * n, eg * n }; }
+    constexpr bool operator==(const PhaseScore&) const = default;
+};
+
 constexpr int nullmove = 0;
 constexpr int max_ply = 128;
 
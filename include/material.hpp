@@ -0,0 +1,80 @@
+#ifndef MATERIAL_HPP_INCLUDE
+#define MATERIAL_HPP_INCLUDE
+
+#include <array>
+#include <cstddef>
+
+#include "globals.hpp"
+
+struct BoardState;
+
+constexpr int SCALE_NORMAL = 64; // Endgame score is kept as is.
+constexpr int SCALE_DRAW = 0;
+constexpr int SCALE_NONE = -1; // Scale function does not apply, use the signature scale.
+constexpr Score KNOWN_WIN = 5000; // Below mate scores, above any material balance.
+
+/// @brief Specialised evaluation of an endgame.
+/// @return Score from strong's view.
+using EndgameEval = Score (*)(const BoardState& state, Colour strong);
+
+/// @brief Position dependent scale factor for the endgame score of strong.
+/// @return A scale factor out of SCALE_NORMAL, or SCALE_NONE.
+using EndgameScale = int (*)(const BoardState& state, Colour strong);
+
+/// @brief What is known about a material signature.
+struct MaterialEntry {
+    Key key = 0;
+    EndgameEval evaluator = nullptr; // Replaces the generic evaluation when set.
+    Colour strong_side = no_colour; // Side evaluator is called for.
+    std::array<EndgameScale, 2> scale_funcs{}; // Indexed by the side ahead in the endgame score.
+    std::array<int, 2> scale = { SCALE_NORMAL, SCALE_NORMAL };
+    bool dead_draw = false; // Neither side can ever mate.
+
+    int scale_factor(const BoardState& state, Colour strong) const {
+        if (scale_funcs[strong]) {
+            int sf = scale_funcs[strong](state, strong);
+            if (sf != SCALE_NONE) return sf;
+        }
+
+        return scale[strong];
+    }
+};
+
+void init_material_entry(MaterialEntry& entry, const BoardState& state);
+
+constexpr size_t MATERIAL_TABLE_SIZE = 1 << 12; // Entries, must be a power of 2.
+
+/// @brief Direct mapped material table, one per search thread.
+class MaterialTable {
+private:
+    std::array<MaterialEntry, MATERIAL_TABLE_SIZE> entries{};
+public:
+    /// @brief Finds the entry for the material key of state, analysing the signature on a miss.
+    const MaterialEntry& probe(Key key, const BoardState& state) {
+        MaterialEntry& entry = entries[key & (MATERIAL_TABLE_SIZE - 1)];
+        if (entry.key != key) {
+            entry = MaterialEntry{};
+            init_material_entry(entry, state);
+            entry.key = key;
+        }
+
+        return entry;
+    }
+
+    /// @brief Drops every entry, needed when the material values change.
+    void clear() { entries.fill(MaterialEntry{}); }
+};
+
+inline thread_local MaterialTable material_table;
+
+namespace endgame {
+    Score kxk(const BoardState& state, Colour strong);
+    Score kbnk(const BoardState& state, Colour strong);
+    Score kpk(const BoardState& state, Colour strong);
+    Score krkp(const BoardState& state, Colour strong);
+
+    int kbpsk(const BoardState& state, Colour strong);
+    int opposite_bishops(const BoardState& state, Colour strong);
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <array>
 #include <bit>
 #include <cassert>
+#include <immintrin.h>
 
 #include "bitboard_math.hpp"
 #include "globals.hpp"
@@ -76,6 +77,61 @@ namespace move_generator {
     alignas(64) inline constexpr std::array<BB, 64> knight_move_table = { 0x20400, 0x50800, 0xa1100, 0x142200, 0x284400, 0x508800, 0xa01000, 0x402000, 0x2040004, 0x5080008, 0xa110011, 0x14220022, 0x28440044, 0x50880088, 0xa0100010, 0x40200020, 0x204000402, 0x508000805, 0xa1100110a, 0x1422002214, 0x2844004428, 0x5088008850, 0xa0100010a0, 0x4020002040, 0x20400040200, 0x50800080500, 0xa1100110a00, 0x142200221400, 0x284400442800, 0x508800885000, 0xa0100010a000, 0x402000204000, 0x2040004020000, 0x5080008050000, 0xa1100110a0000, 0x14220022140000, 0x28440044280000, 0x50880088500000, 0xa0100010a00000, 0x40200020400000, 0x204000402000000, 0x508000805000000, 0xa1100110a000000, 0x1422002214000000, 0x2844004428000000, 0x5088008850000000, 0xa0100010a0000000, 0x4020002040000000, 0x400040200000000, 0x800080500000000, 0x1100110a00000000, 0x2200221400000000, 0x4400442800000000, 0x8800885000000000, 0x100010a000000000, 0x2000204000000000, 0x4020000000000, 0x8050000000000, 0x110a0000000000, 0x22140000000000, 0x44280000000000, 0x88500000000000, 0x10a00000000000, 0x20400000000000 };
     alignas(64) inline constexpr std::array<BB, 64> king_move_table = { 0x302, 0x705, 0xe0a, 0x1c14, 0x3828, 0x7050, 0xe0a0, 0xc040, 0x30203, 0x70507, 0xe0a0e, 0x1c141c, 0x382838, 0x705070, 0xe0a0e0, 0xc040c0, 0x3020300, 0x7050700, 0xe0a0e00, 0x1c141c00, 0x38283800, 0x70507000, 0xe0a0e000, 0xc040c000, 0x302030000, 0x705070000, 0xe0a0e0000, 0x1c141c0000, 0x3828380000, 0x7050700000, 0xe0a0e00000, 0xc040c00000, 0x30203000000, 0x70507000000, 0xe0a0e000000, 0x1c141c000000, 0x382838000000, 0x705070000000, 0xe0a0e0000000, 0xc040c0000000, 0x3020300000000, 0x7050700000000, 0xe0a0e00000000, 0x1c141c00000000, 0x38283800000000, 0x70507000000000, 0xe0a0e000000000, 0xc040c000000000, 0x302030000000000, 0x705070000000000, 0xe0a0e0000000000, 0x1c141c0000000000, 0x3828380000000000, 0x7050700000000000, 0xe0a0e00000000000, 0xc040c00000000000, 0x203000000000000, 0x507000000000000, 0xa0e000000000000, 0x141c000000000000, 0x2838000000000000, 0x5070000000000000, 0xa0e0000000000000, 0x40c0000000000000 };
 
+    /// @brief Squares strictly between two squares on a common rank, file or diagonal, indexed by [sq1][sq2].
+    /// Empty if the squares are not aligned.
+    alignas(64) inline constexpr std::array<std::array<BB, 64>, 64> between_table = []() constexpr {
+        std::array<std::array<BB, 64>, 64> arr{};
+        constexpr std::array<int, 8> file_steps = { 0, 0, 1, -1, 1, -1, 1, -1 };
+        constexpr std::array<int, 8> rank_steps = { 1, -1, 0, 0, 1, 1, -1, -1 };
+        for (Square sq1 = 0; sq1 < 64; ++sq1) {
+            for (int dir = 0; dir < 8; ++dir) {
+                BB ray = 0;
+                int file = (sq1 & 7) + file_steps[dir];
+                int rank = (sq1 >> 3) + rank_steps[dir];
+                while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+                    Square sq2 = 8 * rank + file;
+                    arr[sq1][sq2] = ray;
+                    ray |= BB(1) << sq2;
+                    file += file_steps[dir];
+                    rank += rank_steps[dir];
+                }
+            }
+        }
+
+        return arr;
+    }();
+
+    /// @brief Full rank, file or diagonal through two aligned squares, indexed by [sq1][sq2].
+    /// Empty if the squares are not aligned.
+    alignas(64) inline constexpr std::array<std::array<BB, 64>, 64> line_table = []() constexpr {
+        std::array<std::array<BB, 64>, 64> arr{};
+        constexpr std::array<int, 4> file_steps = { 0, 1, 1, 1 };
+        constexpr std::array<int, 4> rank_steps = { 1, 0, 1, -1 };
+        for (Square sq1 = 0; sq1 < 64; ++sq1) {
+            for (int axis = 0; axis < 4; ++axis) {
+                BB line = BB(1) << sq1;
+                for (int sign : { 1, -1 }) {
+                    int file = (sq1 & 7) + sign * file_steps[axis];
+                    int rank = (sq1 >> 3) + sign * rank_steps[axis];
+                    while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+                        line |= BB(1) << (8 * rank + file);
+                        file += sign * file_steps[axis];
+                        rank += sign * rank_steps[axis];
+                    }
+                }
+
+                BB others = line ^ (BB(1) << sq1);
+                while (others) {
+                    Square sq2 = std::countr_zero(others);
+                    others &= others - 1;
+                    arr[sq1][sq2] = line;
+                }
+            }
+        }
+
+        return arr;
+    }();
+
     /// @brief Magics taken from my old code
     alignas(64) inline constexpr std::array<BB, 64> rook_magics = { 0x6080104000208000, 0x240400010002000, 0x8080200010008008, 0x4080100080080004, 0x2080080004008003, 0x880040080020001, 0x280020000800100, 0x100005021000082, 0x2000802080004000, 0x80200080400c, 0x801000200080, 0x1002008100100, 0x41801800040080, 0x1000400020900, 0x3000200010004, 0x1000080420100, 0x208000804008, 0x1010040002080, 0x10120040208200, 0x808010000800, 0x4000808004000800, 0x101010004000802, 0x4080808002000100, 0x100020000840041, 0x800802080004008, 0x2000500040002000, 0x1004100200010, 0x10008080100800, 0x1004008080080004, 0x20080800400, 0x100a100040200, 0x8200010044, 0x40800101002040, 0x10006000c00040, 0x100080802004, 0x400900089002100, 0x2000510005000800, 0x800400800200, 0x1800200800100, 0x11c0082000041, 0x4180002000404000, 0x800420081020024, 0x200010008080, 0x2000100100210008, 0x60040008008080, 0x4000201004040, 0x4080201040010, 0x4100820004, 0x10800040002080, 0x40002000804080, 0x8000200080100080, 0x8200810010100, 0x8000080080040080, 0x4008004020080, 0x1000010810028400, 0x140100488200, 0x40144100288001, 0x8000820021004012, 0x4100400c200011, 0x11000420081001, 0x802002144100882, 0x1000204000801, 0x8450002000400c1, 0x10004100802402 };
     alignas(64) inline constexpr std::array<BB, 64> bishop_magics = { 0x2088080100440100, 0x8124802410180, 0x4042082000000, 0x29040100c01800, 0x8004042000000004, 0x2080208200010, 0x100a820088000, 0x1008090011080, 0x200042004841480, 0x8020100101041080, 0x11060206120280, 0x10842402800400, 0x11045040000000, 0x2020008250400000, 0x1100004104104000, 0x2104100400, 0x440010408082126, 0x5081001081100, 0x10000800401822, 0x8000800802004010, 0x45000090400000, 0x4085202020200, 0x450202100409, 0x400022080400, 0x4200010021008, 0x2080010300080, 0x10900018004010, 0x8004040080410200, 0x9010000104000, 0x100410022010100, 0x2104004000880400, 0x908009042080, 0x10442010110298, 0x1280298881040, 0x140200040800, 0x400808108200, 0x8040024010030100, 0x8500020010083, 0x84040090005800, 0x404010040002402, 0x2025182010000420, 0x4014014950204800, 0x941088001000, 0x8000a02011002800, 0x1000080100400400, 0x210200a5008200, 0x10014104010100, 0x1014200802a00, 0x1080804840800, 0x220802080200, 0x10020201440800, 0x814084040400, 0x1202020004, 0x800088208020400, 0x2008101002005002, 0x4280200620000, 0x2010402510400, 0x8004202012000, 0x400000028841001, 0x200008000840428, 0x1001040050100, 0x504080201, 0x1020045110110109, 0x1020208102102040, };
@@ -144,11 +200,63 @@ namespace move_generator {
         0x0028440200000000, 0x0050080402000000, 0x0020100804020000, 0x0040201008040200
     };
 
-    /// @brief Magic tables for rook movements
-    alignas(64) inline std::array<std::array<BB, 4096>, 64> rook_movement_table;
+    /// @brief Offsets of each square into the sliding tables, 2^shift slots per square.
+    /// The magic shifts equal the mask sizes, so both backends share the layout.
+    alignas(64) inline constexpr std::array<int, 65> rook_offsets = []() constexpr {
+        std::array<int, 65> arr{};
+        for (Square sq = 0; sq < 64; ++sq)
+            arr[sq + 1] = arr[sq] + (1 << rook_shifts[sq]);
+
+        return arr;
+    }();
+
+    alignas(64) inline constexpr std::array<int, 65> bishop_offsets = []() constexpr {
+        std::array<int, 65> arr{};
+        for (Square sq = 0; sq < 64; ++sq)
+            arr[sq + 1] = arr[sq] + (1 << bishop_shifts[sq]);
+
+        return arr;
+    }();
 
-    /// @brief Magic tables for bishop movements
-    alignas(64) inline std::array<std::array<BB, 512>, 64> bishop_movement_table;
+    static_assert([]() constexpr {
+        for (Square sq = 0; sq < 64; ++sq)
+            if (std::popcount(rook_movement_masks[sq]) != rook_shifts[sq]
+                || std::popcount(bishop_movement_masks[sq]) != bishop_shifts[sq]) return false;
+        return true;
+    }(), "magic shifts must match the movement mask sizes");
+
+    /// @brief Magic tables for rook movements, indexed by rook_offsets[sq] + magic index.
+    /// See https://www.chessprogramming.org/Magic_Bitboards#Fancy.
+    alignas(64) inline std::array<BB, rook_offsets[64]> rook_movement_table;
+
+    /// @brief Magic tables for bishop movements, indexed by bishop_offsets[sq] + magic index.
+    alignas(64) inline std::array<BB, bishop_offsets[64]> bishop_movement_table;
+
+    /// @brief PEXT tables for rook movements, indexed by rook_offsets[sq] + pext(occ, mask).
+    alignas(64) inline std::array<BB, rook_offsets[64]> rook_pext_table;
+
+    /// @brief PEXT tables for bishop movements, indexed by bishop_offsets[sq] + pext(occ, mask).
+    alignas(64) inline std::array<BB, bishop_offsets[64]> bishop_pext_table;
+
+    /// @brief Selects the PEXT backend in rook_moves and bishop_moves, set at startup from CPUID.
+    inline bool use_pext = false;
+
+    /// @brief Parallel bits extract. See https://www.chessprogramming.org/BMI2#PEXTBitboards.
+    /// Only inlined into the move helpers when the build targets BMI2, otherwise it is called through use_pext.
+#ifdef __BMI2__
+    [[gnu::always_inline, gnu::hot]]
+    inline BB pext(BB bb, BB mask) { return _pext_u64(bb, mask); }
+#else
+    [[gnu::target("bmi2"), gnu::hot]]
+    inline BB pext(BB bb, BB mask) { return _pext_u64(bb, mask); }
+#endif
+
+    /// @brief CPUID check for a fast PEXT. Zen 1 and 2 implement it in microcode, magics are faster there.
+    inline bool cpu_has_fast_pext() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi2")
+            && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2");
+    }
 
     /// @brief Generate a variation mask for sliding piece attacks
     inline BB generate_variation_mask(int idx, int pop_c, BB mask) {
@@ -198,7 +306,9 @@ namespace move_generator {
             for (int i = 0; i < variation_count; ++i) {
                 BB variation = generate_variation_mask(i, bits, attack_mask);
                 int magic_idx = (variation * rook_magics[sq]) >> (64 - rook_shifts[sq]);
-                rook_movement_table[sq][magic_idx] = rook_blocked_attacks(sq, variation);
+                BB attacks = rook_blocked_attacks(sq, variation);
+                rook_movement_table[rook_offsets[sq] + magic_idx] = attacks;
+                rook_pext_table[rook_offsets[sq] + i] = attacks;
             }
 
             attack_mask = bishop_movement_masks[sq];
@@ -207,9 +317,13 @@ namespace move_generator {
             for (int i = 0; i < variation_count; ++i) {
                 BB variation = generate_variation_mask(i, bits, attack_mask);
                 int magic_idx = (variation * bishop_magics[sq]) >> (64 - bishop_shifts[sq]);
-                bishop_movement_table[sq][magic_idx] = bishop_blocked_attacks(sq, variation);
+                BB attacks = bishop_blocked_attacks(sq, variation);
+                bishop_movement_table[bishop_offsets[sq] + magic_idx] = attacks;
+                bishop_pext_table[bishop_offsets[sq] + i] = attacks;
             }
         }
+
+        use_pext = cpu_has_fast_pext();
     }
 
     /// @brief Rook moves helper.
@@ -218,10 +332,13 @@ namespace move_generator {
     /// @return Bitboard of moves.
     [[gnu::hot]]
     inline BB rook_moves(Square sq, BB bb) {
+        if (use_pext)
+            return rook_pext_table[rook_offsets[sq] + pext(bb, rook_movement_masks[sq])];
+
         bb &= rook_movement_masks[sq];
         bb *= rook_magics[sq];
         bb >>= 64 - rook_shifts[sq];
-        return rook_movement_table[sq][bb];
+        return rook_movement_table[rook_offsets[sq] + bb];
     }
 
     /// @brief Bishop moves helper.
@@ -230,10 +347,13 @@ namespace move_generator {
     /// @return Bitboard of moves.
     [[gnu::hot]]
     inline BB bishop_moves(Square sq, BB bb) {
+        if (use_pext)
+            return bishop_pext_table[bishop_offsets[sq] + pext(bb, bishop_movement_masks[sq])];
+
         bb &= bishop_movement_masks[sq];
         bb *= bishop_magics[sq];
         bb >>= 64 - bishop_shifts[sq];
-        return bishop_movement_table[sq][bb];
+        return bishop_movement_table[bishop_offsets[sq] + bb];
     }
 
     inline BB x_ray_rook(BB occ, Square rookSq) {
@@ -0,0 +1,58 @@
+#ifndef NNUE_HPP_INCLUDE
+#define NNUE_HPP_INCLUDE
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+
+#include "globals.hpp"
+
+struct BoardState;
+
+extern std::filesystem::path nnue_path;
+
+/// @brief Efficiently updatable neural network evaluation with HalfKP features.
+/// Each side keeps an accumulator: the first layer biases plus the weight rows of its active features,
+/// one per (own king square, non-king piece, square) seen from that side. The side to move's accumulator
+/// and the other one are concatenated and go through 512 -> 32 -> 32 -> 1 clipped ReLU layers.
+namespace nnue {
+    constexpr int HALF_DIMS = 256; // Accumulator size per side.
+    constexpr int FEATURES = 64 * 641; // King square * (10 piece kinds * 64 squares + 1 unused).
+    constexpr int L1_DIMS = 32;
+    constexpr int L2_DIMS = 32;
+    constexpr int WEIGHT_SHIFT = 6; // Hidden layer sums are divided by 64 before clipping to [0, 127].
+    constexpr int FV_SCALE = 16; // Output units per centipawn.
+
+    /// @brief First layer output of both sides for one position of the search stack.
+    struct Accumulator {
+        alignas(64) std::array<std::array<int16_t, HALF_DIMS>, 2> values; // Indexed by perspective.
+        std::array<bool, 2> computed{}; // Cleared by make_move, values are filled in when evaluated.
+    };
+
+    inline bool use_nnue = true; // Set with the UseNNUE option, ignored until a network is loaded.
+
+    /// @brief Loads a network, replacing the current one. The file is "CNN1", the dimensions as
+    /// 3 uint32 (256, 32, 32), then little endian arrays: int16 first layer biases and weights
+    /// [feature][256], then the int32 biases and int8 weights [output][input] of each hidden layer.
+    /// @return false if the file is missing or does not match the dimensions, no network is loaded then.
+    bool load(const std::filesystem::path& path);
+
+    bool is_loaded();
+
+    /// @brief Whether positions are evaluated by the network.
+    inline bool is_enabled() { return use_nnue && is_loaded(); }
+
+    /// @brief Sums the features of every piece into acc from scratch.
+    void refresh(Accumulator& acc, const BoardState& state, Colour perspective);
+
+    /// @brief Derives acc from the accumulator of the previous position, adding and removing the features
+    /// of the pieces that differ between the two. The king of perspective must be on the same square.
+    void update(Accumulator& acc, const Accumulator& parent, const BoardState& state,
+                const BoardState& parent_state, Colour perspective);
+
+    /// @brief Runs the hidden layers on a computed accumulator.
+    /// @return Score from stm's view.
+    Score evaluate(const Accumulator& acc, Colour stm);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PARAMS_HPP_INCLUDE
+#define PARAMS_HPP_INCLUDE
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// @brief Search parameters as X(name, default, min, max).
+#define SEARCH_PARAMS(X) \
+    X(FUTILITY_MARGIN, 125, 0, 500)     /* Per depth squared, 5/4 of a pawn. */ \
+    X(LMP_MOVES, 5, 1, 20)              /* Moves searched before late move pruning. */ \
+    X(NMP_REDUCTION, 3, 1, 6)           /* Null move depth reduction. */ \
+    X(NMP_DEEP_REDUCTION, 4, 1, 8)      /* Null move depth reduction above NMP_DEEP_DEPTH. */ \
+    X(NMP_DEEP_DEPTH, 6, 1, 20) \
+    X(LMR_MIN_DEPTH, 3, 1, 10)          /* Late moves are reduced above this depth. */ \
+    X(LMR_MIN_MOVES, 3, 1, 20)          /* Moves searched before late move reductions. */ \
+    X(LMR_EARLY_MOVES, 6, 1, 30)        /* Moves below this count get LMR_EARLY_REDUCTION. */ \
+    X(LMR_EARLY_REDUCTION, 3, 0, 6) \
+    X(LMR_LATE_MOVES, 8, 1, 40)         /* Moves above this count get LMR_LATE_REDUCTION. */ \
+    X(LMR_LATE_REDUCTION, 4, 0, 8) \
+    X(DELTA_MARGIN, 975, 100, 2000)     /* Quiescence delta pruning margin. */ \
+    X(DELTA_PROMO_MARGIN, 775, 0, 2000) /* Added for promotions. */ \
+    X(ASPIRATION_WINDOW, 25, 5, 200)    /* Half width of the first window. */ \
+    X(ASPIRATION_WIDEN, 50, 5, 500)     /* Added to the failing bound per failure. */
+
+/// @brief Parameters are constants, or variables settable at runtime when built with ENGINE_TUNE.
+#ifdef ENGINE_TUNE
+#define DECLARE_PARAM(name, value, min, max) inline int name = value;
+#else
+#define DECLARE_PARAM(name, value, min, max) constexpr int name = value;
+#endif
+
+SEARCH_PARAMS(DECLARE_PARAM)
+
+#undef DECLARE_PARAM
+
+#ifdef ENGINE_TUNE
+/// @brief Registry of the search parameters and the evaluation terms of eval_params.hpp,
+/// set with setoption, a parameter file, or by the tuner.
+namespace params {
+    struct Param {
+        std::string name;
+        int* value;
+        int min, max;
+        bool is_eval; // Derived evaluation tables need rebuilding after a change.
+    };
+
+    const std::vector<Param>& registry();
+
+    /// @return The parameter called name, or nullptr if there is none.
+    const Param* find(const std::string& name);
+
+    /// @brief Sets a parameter, clamped to its range, and rebuilds what depends on it.
+    /// @return false if there is no parameter called name.
+    bool set(const std::string& name, int value);
+
+    /// @brief Sets the parameters of a file of "name value" lines, # starts a comment.
+    /// @return Number of parameters set, or -1 if the file cannot be read.
+    int load(const std::filesystem::path& path);
+
+    /// @brief Rebuilds the tables derived from the evaluation terms and drops the cached evaluations
+    /// of this thread, after the terms change. Search threads start with empty caches.
+    void rebuild_eval();
+
+    /// @brief Prints a UCI spin option for each parameter.
+    void print_options();
+
+    /// @brief Prints every parameter as a "name value" line, the format load reads.
+    void print();
+}
+#endif
+
+#endif
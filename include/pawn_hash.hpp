@@ -0,0 +1,50 @@
+#ifndef PAWN_HASH_HPP_INCLUDE
+#define PAWN_HASH_HPP_INCLUDE
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "globals.hpp"
+
+/// @brief Pawn structure evaluation and the bitboards derived from it, keyed by the pawn key.
+struct PawnEntry {
+    Key key = 0;
+    PhaseScore score;
+    std::array<BB, 2> half_open_files{}; // Files without pawns of [colour] but with opponent pawns.
+    BB open_files = 0;
+};
+
+constexpr size_t PAWN_HASH_SIZE = 1 << 14; // Entries, must be a power of 2.
+
+/// @brief Direct mapped pawn hash table, one per search thread.
+class PawnHash {
+private:
+    std::vector<PawnEntry> entries = std::vector<PawnEntry>(PAWN_HASH_SIZE);
+public:
+    long probes = 0;
+    long hits = 0;
+
+    /// @brief Finds the slot for key, the caller fills it on a miss.
+    /// @param key Pawn key of the position.
+    /// @return The entry for key, its key differs from key on a miss.
+    PawnEntry& probe(Key key) {
+        probes++;
+        PawnEntry& entry = entries[key & (PAWN_HASH_SIZE - 1)];
+        if (entry.key == key) hits++;
+        return entry;
+    }
+
+    /// @brief Drops every entry, needed when evaluation weights change.
+    void clear() { std::fill(entries.begin(), entries.end(), PawnEntry{}); }
+
+    void reset_stats() {
+        probes = 0;
+        hits = 0;
+    }
+};
+
+inline thread_local PawnHash pawn_hash;
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PERF_COUNTERS_HPP_INCLUDE
+#define PERF_COUNTERS_HPP_INCLUDE
+
+#include <array>
+#include <cstdint>
+
+/// @brief Hardware performance counters of the calling thread, read with Linux perf_event_open.
+/// Events the kernel or container refuses are left unavailable, the others are still counted.
+class PerfCounters {
+public:
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        NUM_EVENTS
+    };
+
+    static constexpr std::array<const char*, NUM_EVENTS> names = {
+        "cycles", "instructions", "l1d misses", "llc misses", "branch misses"
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /// @brief Starts or resumes the available counters, which count from zero when opened.
+    void start();
+
+    /// @brief Pauses the counters and reads their totals, scaled up if the kernel multiplexed them.
+    void stop();
+
+    bool is_available(Event event) const { return fds[event] >= 0; }
+    bool is_any_available() const;
+    uint64_t value(Event event) const { return values[event]; }
+
+private:
+    std::array<int, NUM_EVENTS> fds;
+    std::array<uint64_t, NUM_EVENTS> values{};
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef PROFILER_HPP_INCLUDE
+#define PROFILER_HPP_INCLUDE
+
+/// @brief Times the rest of the enclosing scope as a profiler section, compiled out unless built with ENGINE_PROFILE.
+#ifdef ENGINE_PROFILE
+
+#include <array>
+#include <cstdint>
+#include <x86intrin.h>
+
+#define PROFILE_SCOPE(section) profiler::ScopedTimer profile_timer(profiler::section)
+
+/// @brief Cycle counts of the hot search functions, per thread.
+namespace profiler {
+    enum Section {
+        GENERATE_MOVES,
+        MAKE_MOVE,
+        UNMAKE_MOVE,
+        EVAL,
+        SEE,
+        ORDER_MOVES,
+        TT_PROBE,
+        TT_STORE,
+        NUM_SECTIONS
+    };
+
+    struct Counter {
+        uint64_t calls = 0;
+        uint64_t cycles = 0;
+    };
+
+    inline thread_local std::array<Counter, NUM_SECTIONS> counters{};
+
+    /// @brief Adds the time stamp counter cycles from construction to destruction to a section.
+    /// The two reads cost some tens of cycles, which are included.
+    class ScopedTimer {
+    private:
+        Section section;
+        uint64_t start;
+    public:
+        explicit ScopedTimer(Section section) : section(section), start(__rdtsc()) {}
+
+        ~ScopedTimer() {
+            counters[section].calls++;
+            counters[section].cycles += __rdtsc() - start;
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+    /// @brief Zeroes the counters of this thread and starts the total against which shares are reported.
+    void reset();
+
+    /// @brief Prints the cycles per call of each section of this thread and its share of the cycles since reset.
+    void report();
+}
+
+#else
+#define PROFILE_SCOPE(section)
+#endif
+
+#endif
@@ -8,24 +8,48 @@
 #include <condition_variable>
 
 #include "globals.hpp"
+#include "params.hpp"
 
 #define INF 10000
 #define MATE_VALUE 9000
 #define MAX_DEPTH 20
 #define PV_TABLE_SIZE (max_ply*max_ply+max_ply)/2
 
-#define FUTILITY_MARGIN 125 // 5/4 of a pawn
-
 inline std::atomic<bool> stop_flag;
 
 inline std::array<std::array<Move, 2>, max_ply> killer_moves = {{ nullmove }};
 inline std::array<std::array<std::array<int, 2>, 64>, 64> history_moves {};
-inline long nodes = 0;
+inline long nodes = 0; // Nodes entered in the current iteration, quiescence nodes included.
+inline long total_nodes = 0; // Nodes over every iteration of the last search.
+inline int seldepth = 0; // Deepest ply reached in the current iteration.
 inline std::chrono::steady_clock::time_point start_time;
 inline std::array<Move, PV_TABLE_SIZE> prev_pv_table = { nullmove };
 inline std::array<Move, PV_TABLE_SIZE> iid_pv_table = { nullmove };
 inline Move fallback = nullmove;
 
+/// @brief Wraps statements counting search statistics, compiled out unless built with ENGINE_STATS.
+#ifdef ENGINE_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+/// @brief Counters of the current iteration, printed as an info string to judge pruning changes.
+struct SearchStats {
+    long tt_probes = 0;
+    long tt_hits = 0;
+    long tt_cutoffs = 0;
+    long fail_highs = 0;
+    long first_move_fail_highs = 0; // Fail highs on the first move searched, a measure of move ordering.
+    long null_moves = 0;
+    long null_move_cutoffs = 0;
+    long reductions = 0;
+    long lmr_researches = 0; // Reduced moves that raised alpha and were searched again at full depth.
+    long qnodes = 0;
+};
+
+inline SearchStats search_stats;
+
 /// @brief PV table helper. See https://www.chessprogramming.org/Triangular_PV-Table#Index.
 /// @param ply Ply of pv.
 /// @return The index to the pv table for ply.
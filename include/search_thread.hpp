@@ -0,0 +1,38 @@
+#ifndef SEARCH_THREAD_HPP_INCLUDE
+#define SEARCH_THREAD_HPP_INCLUDE
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// @brief Long lived thread running the searches in the order they are posted. The per-thread pawn hash,
+/// material table and eval cache live on it, so they stay warm from one search to the next.
+/// Anything clearing those caches for the search must be posted here too.
+class SearchThread {
+public:
+    SearchThread();
+    ~SearchThread();
+
+    SearchThread(const SearchThread&) = delete;
+    SearchThread& operator=(const SearchThread&) = delete;
+
+    /// @brief Queues a task, run after those posted before it.
+    void post(std::function<void()> task);
+
+    /// @brief Blocks until every posted task has run.
+    void wait();
+
+private:
+    void loop();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    bool is_busy = false;
+    bool quit = false;
+    std::thread thread; // Declared last, so it starts once the members it uses exist.
+};
+
+#endif
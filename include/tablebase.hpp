@@ -0,0 +1,49 @@
+#ifndef TABLEBASE_HPP_INCLUDE
+#define TABLEBASE_HPP_INCLUDE
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "globals.hpp"
+
+struct BoardState;
+class Board;
+
+extern std::filesystem::path tb_path;
+
+/// @brief Distance to mate tablebases of up to 5 pieces, generated offline with `Engine gentb <material>`.
+/// Each position has a value: 0 is a draw, 255 an unused index, otherwise the distance to mate in plies + 1.
+/// Odd distances are won and even distances lost for the side to move.
+namespace tablebase {
+    constexpr int MAX_PIECES = 5;
+    constexpr uint8_t DRAW = 0;
+    constexpr uint8_t INVALID = 255;
+    constexpr int MAX_DTM = 253; // Longer mates are stored as draws.
+
+    inline int max_pieces = 0; // Most pieces of any loaded table, 0 when none are loaded.
+
+    /// @brief Maps every table file in dir, replacing the loaded tables.
+    /// @return Number of tables loaded.
+    int init(const std::filesystem::path& dir);
+
+    /// @brief Looks up a position. Positions with castling rights or a possible en passant capture are not stored.
+    /// @param value Set to the stored value on success.
+    /// @return Whether a table holds the position.
+    bool probe(const BoardState& state, uint8_t& value);
+
+    /// @brief Converts a stored value to a search score from the side to move's view.
+    Score value_to_score(uint8_t value, int ply);
+
+    /// @brief Finds the move keeping the best result, with the shortest win or the longest loss.
+    /// @param score Set to the score of the root.
+    /// @return The move, or nullmove if the root or one of its children is not in a table.
+    Move probe_root(Board& board, Score& score);
+
+    /// @brief Generates the table of a signature such as "KQvKR", and the missing tables it converts into.
+    /// @param threads Threads sharing each pass over the positions.
+    /// @return false if the signature is invalid or a table could not be written.
+    bool generate(const std::string& material, int threads);
+}
+
+#endif
@@ -13,6 +13,12 @@ namespace tests {
     void test(int depth);
     void test(int start, int stop, bool divide = true);
     void perft_suite();
+    void slider_bench();
+    void bench(int depth, bool use_perf = false);
+    void kpk_suite();
+    void nnue_suite();
+    void eval_cost();
+    void eval_trace(Board& board);
 
 }
 
@@ -15,12 +15,15 @@ enum EntryType {
     UPPER
 };
 
+constexpr Score NO_EVAL = -32768; // Static eval not stored, below any real score.
+
 struct alignas(64) TranspositionEntry {
     Key key;
     Move hash_move;
     int depth;
-    int age;
+    int age = 0; // Search the entry was stored in, set by store_entry.
     Score score;
+    Score static_eval = NO_EVAL;
     EntryType type;
 };
 
@@ -34,6 +37,7 @@ class Transposition {
 private:
     TranspositionEntry* transposition_tt = nullptr;
     size_t transposition_size = 0;
+    int age = 0;
     void init(size_t size);
 public:
     Transposition(size_t size = 0) {
@@ -53,9 +57,17 @@ public:
     bool is_initialised = false;
 
     void clear_tt();
+
+    /// @brief Starts a new search, entries of earlier searches become replaceable.
+    void new_search() { age++; }
+    TranspositionEntry* probe(Key key);
     TranspositionEntry* probe(Key key, int depth);
     void store_entry(TranspositionEntry& entry);
     float usage() const;
+
+    /// @brief Occupancy sampled over the first 1000 entries, cheap enough for every info line.
+    /// @return Permille of the sampled entries in use.
+    int hashfull() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef TUNE_HPP_INCLUDE
+#define TUNE_HPP_INCLUDE
+
+#include <filesystem>
+
+/// @brief Texel tuning of the evaluation terms in eval_params.hpp, run with `Engine tune <dataset.epd> [threads] [epochs]`.
+/// Each dataset line is a FEN followed by a result from white's view, as "1-0", "0-1" or "1/2-1/2" in quotes, or [1.0], [0.5] or [0.0].
+namespace tuner {
+    /// @brief Minimises the mean squared error between the results and the sigmoid of the evaluation,
+    /// then writes eval_params.hpp with the tuned terms to the working directory.
+    /// @param threads Threads sharing the loading and each pass over the positions.
+    /// @return false if the dataset has no usable positions or the output could not be written.
+    bool tune(const std::filesystem::path& dataset, int threads, int epochs);
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../include/batch.hpp"
+#include "../include/board.hpp"
+#include "../include/search.hpp"
+
+namespace {
+    constexpr size_t CHUNK_BYTES = 1 << 24; // Read at a time, the lines of a chunk are evaluated together.
+
+    /// Whole lines of the input, a partial last line is carried over to the next chunk.
+    struct Chunk {
+        std::string text;
+        std::vector<std::string_view> lines;
+    };
+
+    /// Fills chunk with the carry and the next bytes of in, up to the last complete line.
+    void read_chunk(std::ifstream& in, Chunk& chunk, std::string& carry) {
+        chunk.text = std::move(carry);
+        carry.clear();
+        chunk.lines.clear();
+
+        size_t old_size = chunk.text.size();
+        chunk.text.resize(old_size + CHUNK_BYTES);
+        in.read(chunk.text.data() + old_size, CHUNK_BYTES);
+        chunk.text.resize(old_size + in.gcount());
+
+        // Without more input, an unterminated last line is complete.
+        size_t end = chunk.text.rfind('\n');
+        if (in && end != std::string::npos) {
+            carry.assign(chunk.text, end + 1);
+            chunk.text.resize(end + 1);
+        }
+
+        std::string_view text = chunk.text;
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            std::string_view line = text.substr(0, newline);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            chunk.lines.push_back(line);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        }
+    }
+
+    /// Appends the evaluation of a line from white's view, or "invalid", to out.
+    bool eval_line(Board& board, std::string_view line, std::string& out) {
+        if (!board.load_fen(line)) {
+            out += "invalid\n";
+            return false;
+        }
+
+        Score score = board.eval();
+        if (board.state.side_to_move == black) score = -score;
+
+        char buffer[16];
+        char* end = std::to_chars(buffer, buffer + sizeof(buffer), score).ptr;
+        *end++ = '\n';
+        out.append(buffer, end);
+        return true;
+    }
+}
+
+bool batch::eval_file(const std::filesystem::path& in_path, const std::filesystem::path& out_path, int threads) {
+    std::ifstream in(in_path, std::ios::binary);
+    if (!in) {
+        std::println("info string cannot open {}", in_path.string());
+        return false;
+    }
+
+    std::ofstream out(out_path, std::ios::binary);
+    if (!out) {
+        std::println("info string cannot open {}", out_path.string());
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<Board>> boards;
+    for (int t = 0; t < threads; ++t) boards.push_back(std::make_unique<Board>());
+
+    // Workers evaluate their share of the current chunk between two barrier phases,
+    // while the main thread reads the next chunk. Each formats its lines into its own output.
+    std::array<Chunk, 2> chunks;
+    const Chunk* current = nullptr;
+    bool done = false;
+    std::vector<std::string> outputs(threads);
+    std::vector<long> invalid(threads);
+    std::barrier sync(threads + 1);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            while (true) {
+                sync.arrive_and_wait();
+                if (done) return;
+
+                size_t size = current->lines.size();
+                outputs[t].clear();
+                for (size_t i = size * t / threads; i < size * (t + 1) / threads; ++i)
+                    invalid[t] += !eval_line(*boards[t], current->lines[i], outputs[t]);
+                sync.arrive_and_wait();
+            }
+        });
+    }
+
+    std::string carry;
+    long positions = 0;
+    size_t idx = 0;
+    read_chunk(in, chunks[idx], carry);
+    while (!chunks[idx].lines.empty()) {
+        current = &chunks[idx];
+        sync.arrive_and_wait();
+        read_chunk(in, chunks[idx ^ 1], carry);
+        sync.arrive_and_wait();
+
+        for (const std::string& text : outputs) out.write(text.data(), text.size());
+        positions += current->lines.size();
+        idx ^= 1;
+    }
+
+    done = true;
+    sync.arrive_and_wait();
+    for (std::thread& worker : workers) worker.join();
+
+    out.flush();
+    if (!out) {
+        std::println("info string cannot write {}", out_path.string());
+        return false;
+    }
+
+    long invalid_lines = 0;
+    for (long count : invalid) invalid_lines += count;
+    int elapsed = std::max(elapsed_ms(start), 1);
+    std::println("info string evaluated {} positions, {} invalid, in {}ms, {} positions/s",
+        positions, invalid_lines, elapsed, positions * 1000 / elapsed);
+    return true;
+}
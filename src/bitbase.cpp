@@ -0,0 +1,126 @@
+#include <bitset>
+#include <vector>
+
+#include "../include/bitbase.hpp"
+#include "../include/board.hpp"
+
+using namespace bb_math;
+using namespace move_generator;
+
+namespace {
+    constexpr int KPK_SIZE = 2 * 24 * 64 * 64;
+
+    std::bitset<KPK_SIZE> kpk_wins; // Set when white, the pawn side, wins.
+    bool is_initialised = false;
+
+    /// Pawn files a-d and ranks 2-7 give 24 pawn squares.
+    inline int kpk_index(Colour stm, Square white_king, Square black_king, Square pawn) {
+        return white_king | (black_king << 6) | (stm << 12) | (get_file(pawn) << 13) | ((6 - get_rank(pawn)) << 15);
+    }
+
+    // Results are bit flags, a position is classified by or-ing the results of its successors.
+    enum Result : uint8_t { INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4 };
+
+    struct KPKPosition {
+        Colour stm;
+        Square white_king, black_king, pawn;
+        Result result;
+
+        KPKPosition(int idx) {
+            white_king = idx & 63;
+            black_king = (idx >> 6) & 63;
+            stm = (idx >> 12) & 1;
+            pawn = ((idx >> 13) & 3) + 8 * (6 - ((idx >> 15) & 7));
+
+            BB pawn_attacks = pawn_attack_table[pawn][white];
+            Square promo_sq = pawn + 8;
+
+            if (distance(white_king, black_king) <= 1 || white_king == pawn || black_king == pawn
+                || (stm == white && get_bit(pawn_attacks, black_king)))
+                result = INVALID;
+
+            // The pawn promotes safely.
+            else if (stm == white && get_rank(pawn) == 6 && white_king != promo_sq && black_king != promo_sq
+                     && (distance(black_king, promo_sq) > 1 || distance(white_king, promo_sq) == 1))
+                result = WIN;
+
+            // Stalemate, or the pawn is captured.
+            else if (stm == black && ((king_move_table[black_king] & ~(king_move_table[white_king] | pawn_attacks)) == 0
+                     || get_bit(king_move_table[black_king] & ~king_move_table[white_king], pawn)))
+                result = DRAW;
+
+            else
+                result = UNKNOWN;
+        }
+
+        /// White wins if any move wins, black draws if any move draws, otherwise unknown until a successor is known.
+        Result classify(const std::vector<KPKPosition>& db) const {
+            Result good = stm == white ? WIN : DRAW;
+            Result bad = stm == white ? DRAW : WIN;
+
+            int r = INVALID;
+            BB king_moves = king_move_table[stm == white ? white_king : black_king];
+            while (king_moves) {
+                Square to = bitscan_forward(king_moves);
+                pop_bit(king_moves, to);
+                r |= stm == white ? db[kpk_index(black, to, black_king, pawn)].result
+                                  : db[kpk_index(white, white_king, to, pawn)].result;
+            }
+
+            if (stm == white && get_rank(pawn) < 6) {
+                Square push = pawn + 8;
+                if (push != white_king && push != black_king) {
+                    r |= db[kpk_index(black, white_king, black_king, push)].result;
+
+                    Square double_push = push + 8;
+                    if (get_rank(pawn) == 1 && double_push != white_king && double_push != black_king)
+                        r |= db[kpk_index(black, white_king, black_king, double_push)].result;
+                }
+            }
+
+            return (r & good) ? good : (r & UNKNOWN) ? UNKNOWN : bad;
+        }
+    };
+}
+
+void bitbase::init() {
+    if (is_initialised) return;
+
+    std::vector<KPKPosition> db;
+    db.reserve(KPK_SIZE);
+    for (int idx = 0; idx < KPK_SIZE; ++idx)
+        db.emplace_back(idx);
+
+    // Iterate until no unknown position can be resolved, the rest are draws.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (KPKPosition& pos : db) {
+            if (pos.result != UNKNOWN) continue;
+            pos.result = pos.classify(db);
+            changed |= pos.result != UNKNOWN;
+        }
+    }
+
+    for (int idx = 0; idx < KPK_SIZE; ++idx)
+        if (db[idx].result == WIN) kpk_wins.set(idx);
+
+    is_initialised = true;
+}
+
+bool bitbase::probe_kpk(Square strong_king, Square pawn, Square weak_king, Colour strong, Colour stm) {
+    // Seen from the pawn side, with the pawn on the queen side.
+    if (strong == black) {
+        strong_king = flip_rank(strong_king);
+        pawn = flip_rank(pawn);
+        weak_king = flip_rank(weak_king);
+    }
+
+    if (get_file(pawn) >= 4) {
+        strong_king ^= 7;
+        pawn ^= 7;
+        weak_king ^= 7;
+    }
+
+    return kpk_wins[kpk_index(stm == strong ? white : black, strong_king, weak_king, pawn)];
+}
@@ -1,9 +1,12 @@
+#include <charconv>
+#include <mutex>
 #include <print>
-#include <sstream>
 
 #include "../include/board.hpp"
+#include "../include/eval.hpp"
 #include "../include/utils.hpp"
 #include "../include/book.hpp"
+#include "../include/profiler.hpp"
 
 using namespace bb_math;
 using namespace move_generator;
@@ -18,46 +21,74 @@ void BoardState::reset() {
     halfmove_clock = 0;
     fullmove_counter = 1;
     hash_key = 0;
+    pawn_key = 0;
+    material_key = 0;
+    psqt = {};
+    phase = 0;
+    is_in_check = false;
+    checkers = 0;
+    blockers.fill(0);
+    check_squares.fill(0);
 }
 
-void Board::load_fen(std::string fen) {
+void Board::init_tables() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        move_generator::init_sliding_move_tables();
+        zobrist::init_keys();
+        cuckoo::init();
+        bitbase::init();
+    });
+}
+
+bool Board::load_fen(std::string_view fen) {
     state.reset();
 
-    std::istringstream ss(fen);
-    std::string board_part, stm, castling, enpassant, halfmove, fullmove;
+    size_t pos = 0;
+    auto next_field = [&]() {
+        while (pos < fen.size() && (fen[pos] == ' ' || fen[pos] == '\t')) pos++;
+        size_t start = pos;
+        while (pos < fen.size() && fen[pos] != ' ' && fen[pos] != '\t' && fen[pos] != '\r' && fen[pos] != '\n') pos++;
+        return fen.substr(start, pos - start);
+    };
 
-    ss >> board_part >> stm >> castling >> enpassant >> halfmove >> fullmove;
+    std::string_view board_part = next_field(), stm = next_field(), castling = next_field(), enpassant = next_field();
+    if (enpassant.empty()) return false;
 
     Square sq = 0;
     for (char c : board_part) {
-        if (isdigit(c)) {
+        if (c >= '1' && c <= '8') {
             sq += c - '0';
         } else if (c == '/') {
             continue;
         } else {
             Piece piece_idx = char_to_piece(c);
-            Square flip_sq = flip_rank(sq);  
+            if (piece_idx == no_piece || sq >= 64) return false;
+            Square flip_sq = flip_rank(sq);
             state.piece_list[flip_sq] = piece_idx;
             state.bitboards[piece_idx] |= mask(flip_sq);
             sq++;
         }
     }
 
+    if (sq != 64 || pop_count(state.bitboards[K]) != 1 || pop_count(state.bitboards[k]) != 1) return false;
+
+    if (stm != "w" && stm != "b") return false;
     state.side_to_move = (stm == "w") ? white : black;
 
     state.castling_rights = 0;
-    if (castling != "-") {
-        for (char c : castling) {
-            switch (c) {
-                case 'K': state.castling_rights |= wking_side; break;
-                case 'Q': state.castling_rights |= wqueen_side; break;
-                case 'k': state.castling_rights |= bking_side; break;
-                case 'q': state.castling_rights |= bqueen_side; break;
-            }
+    for (char c : castling) {
+        switch (c) {
+            case 'K': state.castling_rights |= wking_side; break;
+            case 'Q': state.castling_rights |= wqueen_side; break;
+            case 'k': state.castling_rights |= bking_side; break;
+            case 'q': state.castling_rights |= bqueen_side; break;
         }
     }
 
     if (enpassant != "-") {
+        if (enpassant.size() != 2 || enpassant[0] < 'a' || enpassant[0] > 'h' || (enpassant[1] != '3' && enpassant[1] != '6'))
+            return false;
         int file = enpassant[0] - 'a';
         int rank = enpassant[1] - '1';
         state.enpassant_square = file + 8 * rank;
@@ -65,9 +96,30 @@ void Board::load_fen(std::string fen) {
         state.enpassant_square = no_square;
     }
 
-    state.halfmove_clock = stoi(halfmove);
-    state.fullmove_counter = stoi(fullmove);
+    // Counters default to 0 and 1 when missing, a field that is not a number ends the FEN.
+    std::string_view halfmove = next_field();
+    if (std::from_chars(halfmove.data(), halfmove.data() + halfmove.size(), state.halfmove_clock).ec == std::errc()) {
+        std::string_view fullmove = next_field();
+        std::from_chars(fullmove.data(), fullmove.data() + fullmove.size(), state.fullmove_counter);
+    }
+
+    refresh_state();
+    return true;
+}
+
+void Board::load_pieces(std::span<const Piece> pieces, std::span<const Square> squares, Colour stm) {
+    state.reset();
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        state.piece_list[squares[i]] = pieces[i];
+        state.bitboards[pieces[i]] |= mask(squares[i]);
+    }
+
+    state.side_to_move = stm;
+    refresh_state();
+}
 
+/// Derives the occupancies, keys, scores and check info from the piece placement.
+void Board::refresh_state() {
     state.bitboards[12] = state.bitboards[p] | state.bitboards[n] | state.bitboards[b] |
                           state.bitboards[r] | state.bitboards[q] | state.bitboards[k];
     state.bitboards[13] = state.bitboards[P] | state.bitboards[N] | state.bitboards[B] |
@@ -75,6 +127,15 @@ void Board::load_fen(std::string fen) {
     state.bitboards[14] = state.bitboards[12] | state.bitboards[13];
 
     state.hash_key = zobrist::gen_pos_key(state);
+    state.pawn_key = zobrist::gen_pawn_key(state);
+    state.material_key = zobrist::gen_material_key(state);
+    state.psqt = eval_psqt();
+    state.phase = eval_phase();
+
+    if (state.side_to_move == white) update_check_info<white>();
+    else update_check_info<black>();
+
+    accumulators[prev_state_idx].computed = {};
 }
 
 void Board::print_board() {
@@ -168,41 +229,19 @@ BB Board::get_attacked_BB(Colour side) {
     BB occ_ex_king = ((state.bitboards[k] | state.bitboards[K]) & ~opponent_pieces) ^ occ;
     BB opp_any_attacks = 0;
     Square king_sq = bitscan_forward((state.bitboards[k] | state.bitboards[K]) & friendly_pieces);
-    BB opp_attacks = 0;
 
     BB opp_rooks = (state.bitboards[r] | state.bitboards[R] | state.bitboards[q] | state.bitboards[Q]) & opponent_pieces;
-    
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, west);
-    opp_any_attacks |= opp_attacks;
-
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, east);
-    opp_any_attacks |= opp_attacks;
-
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, nort);
-    opp_any_attacks |= opp_attacks;
-
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, sout);
-    opp_any_attacks |= opp_attacks;
-    
     BB opp_bishops = (state.bitboards[b] | state.bitboards[B] | state.bitboards[q] | state.bitboards[Q]) & opponent_pieces;
-    
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, noEast);
-    opp_any_attacks |= opp_attacks;
 
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, soWest);
-    opp_any_attacks |= opp_attacks;
-
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, soEast);
-    opp_any_attacks |= opp_attacks;
-
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, noWest);
-    opp_any_attacks |= opp_attacks;
+    // Orthogonal and diagonal rays, four directions per call.
+    opp_any_attacks |= sliding_attacks4({ opp_rooks, opp_rooks, opp_rooks, opp_rooks }, occ_ex_king, { nort, sout, east, west });
+    opp_any_attacks |= sliding_attacks4({ opp_bishops, opp_bishops, opp_bishops, opp_bishops }, occ_ex_king, { noEast, noWest, soEast, soWest });
 
     // Non-sliding pieces
     opp_any_attacks |= knight_attacks((state.bitboards[n] | state.bitboards[N]) & opponent_pieces);
     opp_any_attacks |= king_attacks((state.bitboards[k] | state.bitboards[K]) & opponent_pieces);
     
-    if (state.side_to_move == white)
+    if (side == white)
         opp_any_attacks |= bpawn_attacks(state.bitboards[p]);
     else
         opp_any_attacks |= wpawn_attacks(state.bitboards[P]);
@@ -231,96 +270,135 @@ BB Board::sq_attacked_by(BB occ, Square sq) {
 }
 
 bool Board::is_side_in_check(Colour side) {
-    return state.bitboards[k + (side == white ? 6 : 0)] & get_attacked_BB(side);
-}
+    if (side == state.side_to_move) return state.checkers;
 
-template <bool GEN_CAPTURES>
-[[gnu::hot]]
-void Board::generate_moves() {
-
-    // Handle the movement mask
-    BB move_mask = ~0;
-    BB white_mask = -(state.side_to_move == white); // All 1s if white to move, else 0s
-    BB black_mask = ~white_mask;
+    Square king_sq = bitscan_forward(state.bitboards[k + (side == white ? 6 : 0)]);
+    BB opponent_pieces = state.bitboards[side == white ? bpieces : wpieces];
+    return sq_attacked_by(state.bitboards[allpieces], king_sq) & opponent_pieces;
+}
 
-    BB wh = state.bitboards[wpieces];
-    BB bl = state.bitboards[bpieces];
+bool Board::gives_check(Move move) {
+    Colour us = state.side_to_move;
+    Piece ours = us == white ? P : p;
+    Square from_sq = get_from_sq(move);
+    Square to_sq = get_to_sq(move);
+    Code code = get_code(move);
+    Piece piece_type = state.piece_list[from_sq] - ours;
+    BB their_king = state.bitboards[us == white ? k : K];
+    Square their_king_sq = bitscan_forward(their_king);
     BB occ = state.bitboards[allpieces];
 
-    BB opponent_pieces = (bl & white_mask) | (wh & black_mask); // isolates opponent pieces
-
-    if constexpr (GEN_CAPTURES)
-        move_mask = opponent_pieces;
+    // Direct check, promotions are handled below with the new piece.
+    if (code < npromo && get_bit(state.check_squares[piece_type], to_sq))
+        return true;
+
+    // Discovered check, the moving piece leaves the line between a slider and the king.
+    if (get_bit(state.blockers[us ^ 1], from_sq) && !get_bit(line_table[their_king_sq][from_sq], to_sq))
+        return true;
+
+    if (code >= npromo) {
+        BB promo_occ = occ ^ mask(from_sq);
+        switch (code & 3) {
+            case 0: return knight_move_table[to_sq] & their_king;
+            case 1: return bishop_moves(to_sq, promo_occ) & their_king;
+            case 2: return rook_moves(to_sq, promo_occ) & their_king;
+            default: return (rook_moves(to_sq, promo_occ) | bishop_moves(to_sq, promo_occ)) & their_king;
+        }
+    }
 
-    // Check mask
-    BB friendly_pieces = (bl & black_mask) | (wh & white_mask);
-    BB hor_inbetween = 0, ver_inbetween = 0, dia_inbetween = 0, antdia_inbetween = 0;
-    BB occ_ex_king = ((state.bitboards[k] | state.bitboards[K]) & ~opponent_pieces) ^ occ;
-    BB opp_any_attacks = 0;
-    BB kingBB = (state.bitboards[k] | state.bitboards[K]) & friendly_pieces;
-    Square king_sq = bitscan_forward(kingBB);
-    BB king_super_dia = bishop_moves(king_sq, occ);
-    BB king_super_orth = rook_moves(king_sq, occ);
-    BB opp_attacks = 0;
+    // The captured pawn may also uncover a slider.
+    if (code == epcapture) {
+        Square cap_sq = us == white ? to_sq - 8 : to_sq + 8;
+        BB ep_occ = (occ ^ mask(from_sq) ^ mask(cap_sq)) | mask(to_sq);
+        BB rooks = state.bitboards[ours + r] | state.bitboards[ours + q];
+        BB bishops = state.bitboards[ours + b] | state.bitboards[ours + q];
+        return (rook_moves(their_king_sq, ep_occ) & rooks) | (bishop_moves(their_king_sq, ep_occ) & bishops);
+    }
 
-    BB opp_rooks = (state.bitboards[r] | state.bitboards[R] | state.bitboards[q] | state.bitboards[Q]) & opponent_pieces;
-    
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, west);
-    opp_any_attacks |= opp_attacks;
-    hor_inbetween |= opp_attacks & king_super_orth & precomp_east_fill[king_sq];
+    // The castled rook may check, with the king already off its start square.
+    if (code == kcastle || code == qcastle) {
+        Square rook_from = code == kcastle ? from_sq + 3 : from_sq - 4;
+        Square rook_to = code == kcastle ? from_sq + 1 : from_sq - 1;
+        BB castle_occ = (occ ^ mask(from_sq) ^ mask(rook_from)) | mask(to_sq) | mask(rook_to);
+        return rook_moves(rook_to, castle_occ) & their_king;
+    }
 
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, east);
-    opp_any_attacks |= opp_attacks;
-    hor_inbetween |= opp_attacks & king_super_orth & precomp_west_fill[king_sq];
+    return false;
+}
 
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, nort);
-    opp_any_attacks |= opp_attacks;
-    ver_inbetween |= opp_attacks & king_super_orth & precomp_sout_fill[king_sq];
+BB Board::slider_blockers(Square king_sq, BB rooks, BB bishops) {
+    BB occ = state.bitboards[allpieces];
+    BB snipers = (rook_moves(king_sq, 0) & rooks) | (bishop_moves(king_sq, 0) & bishops);
+    BB blockers = 0;
 
-    opp_attacks = sliding_attacks(opp_rooks, occ_ex_king, sout);
-    opp_any_attacks |= opp_attacks;
-    ver_inbetween |= opp_attacks & king_super_orth & precomp_nort_fill[king_sq];
-    
-    BB opp_bishops = (state.bitboards[b] | state.bitboards[B] | state.bitboards[q] | state.bitboards[Q]) & opponent_pieces;
-    
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, noEast);
-    opp_any_attacks |= opp_attacks;
-    dia_inbetween |= opp_attacks & king_super_dia & precomp_soWest_fill[king_sq];
+    while (snipers) {
+        Square sniper_sq = pop_lsb(snipers);
+        BB inbetween = between_table[king_sq][sniper_sq] & occ;
 
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, soWest);
-    opp_any_attacks |= opp_attacks;
-    dia_inbetween |= opp_attacks & king_super_dia & precomp_noEast_fill[king_sq];;
+        // Exactly one piece between the king and the slider.
+        if (inbetween && !(inbetween & (inbetween - 1)))
+            blockers |= inbetween;
+    }
 
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, soEast);
-    opp_any_attacks |= opp_attacks;
-    antdia_inbetween |= opp_attacks & king_super_dia & precomp_noWest_fill[king_sq];
+    return blockers;
+}
 
-    opp_attacks = sliding_attacks(opp_bishops, occ_ex_king, noWest);
-    opp_any_attacks |= opp_attacks;
-    antdia_inbetween |= opp_attacks & king_super_dia & precomp_soEast_fill[king_sq];
+template <Colour US>
+void Board::update_check_info() {
+    constexpr Colour THEM = US ^ 1;
+    constexpr Piece OURS = US == white ? P : p;
+    constexpr Piece THEIRS = US == white ? p : P;
 
-    // Non-sliding pieces
-    opp_any_attacks |= knight_attacks((state.bitboards[n] | state.bitboards[N]) & opponent_pieces);
-    opp_any_attacks |= king_attacks((state.bitboards[k] | state.bitboards[K]) & opponent_pieces);
-    BB kings = (state.bitboards[k] | state.bitboards[K]) & opponent_pieces;
-    
-    if (state.side_to_move == white)
-        opp_any_attacks |= bpawn_attacks(state.bitboards[p]);
-    else
-        opp_any_attacks |= wpawn_attacks(state.bitboards[P]);
+    BB occ = state.bitboards[allpieces];
+    Square king_sq = bitscan_forward(state.bitboards[OURS + k]);
+    Square their_king_sq = bitscan_forward(state.bitboards[THEIRS + k]);
+    BB our_rooks = state.bitboards[OURS + r] | state.bitboards[OURS + q];
+    BB our_bishops = state.bitboards[OURS + b] | state.bitboards[OURS + q];
+    BB their_rooks = state.bitboards[THEIRS + r] | state.bitboards[THEIRS + q];
+    BB their_bishops = state.bitboards[THEIRS + b] | state.bitboards[THEIRS + q];
+
+    BB rook_lines = rook_moves(their_king_sq, occ);
+    BB bishop_lines = bishop_moves(their_king_sq, occ);
+
+    state.checkers = (pawn_attack_table[king_sq][US] & state.bitboards[THEIRS + p])
+                    | (knight_move_table[king_sq] & state.bitboards[THEIRS + n])
+                    | (rook_moves(king_sq, occ) & their_rooks)
+                    | (bishop_moves(king_sq, occ) & their_bishops);
+    state.is_in_check = state.checkers != 0;
+
+    state.blockers[US] = slider_blockers(king_sq, their_rooks, their_bishops);
+    state.blockers[THEM] = slider_blockers(their_king_sq, our_rooks, our_bishops);
+
+    state.check_squares[p] = pawn_attack_table[their_king_sq][THEM];
+    state.check_squares[n] = knight_move_table[their_king_sq];
+    state.check_squares[b] = bishop_lines;
+    state.check_squares[r] = rook_lines;
+    state.check_squares[q] = bishop_lines | rook_lines;
+    state.check_squares[k] = 0;
+}
 
-    
-    BB all_inbetween = hor_inbetween | ver_inbetween | antdia_inbetween | dia_inbetween;
-    BB block_mask = all_inbetween & ~occ;
-    BB checkers_mask = (king_super_orth & opp_rooks) | (king_super_dia & opp_bishops) 
-    | (knight_move_table[king_sq] & (state.bitboards[n] | state.bitboards[N]) & opponent_pieces)
-    | (pawn_attack_table[king_sq][state.side_to_move] & (state.bitboards[p] | state.bitboards[P]) & opponent_pieces);
+template void Board::update_check_info<white>();
+template void Board::update_check_info<black>();
 
-    int64_t null_if_check = (int64_t(opp_any_attacks & mask(king_sq)) - 1) >> 63;
-    int64_t null_if_dbl_check = (int64_t(checkers_mask & (checkers_mask - 1)) - 1) >> 63;
+template <Colour US, bool GEN_CAPTURES>
+[[gnu::hot]]
+void Board::generate_moves() {
+    PROFILE_SCOPE(GENERATE_MOVES);
+    constexpr Piece OURS = US == white ? P : p; // Offset of the friendly pieces
+    constexpr Dir UP = US == white ? nort : sout;
+    constexpr int UP_DELTA = US == white ? 8 : -8;
+    constexpr BB dbl_rank = US == white ? 0x00000000FF000000ULL : 0x000000FF00000000ULL;
+    constexpr BB promo_rank = US == white ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
 
-    BB to_checkers_mask = checkers_mask | block_mask | null_if_check;
-    move_mask &= ~friendly_pieces & to_checkers_mask & null_if_dbl_check;
+    BB occ = state.bitboards[allpieces];
+    BB friendly_pieces = state.bitboards[US == white ? wpieces : bpieces];
+    BB opponent_pieces = state.bitboards[US == white ? bpieces : wpieces];
+    Square king_sq = bitscan_forward(state.bitboards[OURS + k]);
+
+    // Checkers and pins are cached by make_move.
+    BB checkers = state.checkers;
+    BB pinned = state.blockers[US] & friendly_pieces;
+    BB opp_any_attacks = get_attacked_BB(US);
     state.move_list.clear();
     
     BB king_movement = king_move_table[king_sq] & ~(friendly_pieces | opp_any_attacks);
@@ -330,13 +408,16 @@ void Board::generate_moves() {
         state.move_list.add(generate_move_nopromo(king_sq, to_sq));
     }
 
-    state.is_in_check = null_if_check == 0;
-    
     // If dbl check only king moves are allowed
-    if (move_mask == 0) return;
+    if (checkers & (checkers - 1)) return;
+
+    // Handle the movement mask, in check only captures of the checker and blocks are allowed.
+    BB move_mask = GEN_CAPTURES ? opponent_pieces : ~friendly_pieces;
+    if (checkers)
+        move_mask &= checkers | between_table[king_sq][bitscan_forward(checkers)];
     
     // Pinned knights cannot move
-    BB knights = (state.bitboards[n] | state.bitboards[N]) & friendly_pieces & ~all_inbetween;
+    BB knights = state.bitboards[OURS + n] & ~pinned;
     while (knights) {
         Square from_sq = pop_lsb(knights);
         BB movement = knight_move_table[from_sq] & move_mask;
@@ -347,16 +428,12 @@ void Board::generate_moves() {
     }
 
     // Rook and Queen moves
-    BB rooks = (state.bitboards[r] | state.bitboards[R] | state.bitboards[q] | state.bitboards[Q]) & friendly_pieces;
+    BB rooks = state.bitboards[OURS + r] | state.bitboards[OURS + q];
 
     while (rooks) {
         Square from_sq = pop_lsb(rooks);
         BB moves = move_mask & rook_moves(from_sq, occ);
-        if (get_bit(all_inbetween, from_sq)) {
-            if (get_bit(hor_inbetween, from_sq)) moves &= precomp_hor_fill[from_sq];
-            else if (get_bit(ver_inbetween, from_sq)) moves &= precomp_ver_fill[from_sq];
-            else if (get_bit(dia_inbetween | antdia_inbetween, from_sq)) moves &= 0;
-        }
+        if (get_bit(pinned, from_sq)) moves &= line_table[king_sq][from_sq];
 
         while (moves) {
             Square to_sq = pop_lsb(moves);
@@ -365,16 +442,12 @@ void Board::generate_moves() {
     }
 
     // Queen and bishop moves
-    BB bishops = (state.bitboards[b] | state.bitboards[B] | state.bitboards[q] | state.bitboards[Q]) & friendly_pieces;
+    BB bishops = state.bitboards[OURS + b] | state.bitboards[OURS + q];
 
     while (bishops) {
         Square from_sq = pop_lsb(bishops);
         BB moves = move_mask & bishop_moves(from_sq, occ);
-        if (get_bit(all_inbetween, from_sq)) {
-            if (get_bit(dia_inbetween, from_sq)) moves &= precomp_dia_fill[from_sq];
-            else if (get_bit(antdia_inbetween, from_sq)) moves &= precomp_antdia_fill[from_sq];
-            else if (get_bit(hor_inbetween | ver_inbetween, from_sq)) moves &= 0;
-        }
+        if (get_bit(pinned, from_sq)) moves &= line_table[king_sq][from_sq];
 
         while (moves) {
             Square to_sq = pop_lsb(moves);
@@ -383,65 +456,51 @@ void Board::generate_moves() {
     }
 
     // Pawn Moves
-    BB pawns = (state.bitboards[p] | state.bitboards[P]) & friendly_pieces  & ~(all_inbetween ^ ver_inbetween);
-    BB pawn_push_mask = shift_one(pawns, Dir(int(sout) ^ state.side_to_move)) & ~occ;
-    BB rank4 = 0x00000000FF000000ULL;
-    BB rank5 = 0x000000FF00000000ULL;
-    BB dbl_rank = (state.side_to_move == white) ? rank4 : rank5;
-    while (pawns) {
-        Square from_sq = pop_lsb(pawns);
+    BB pawns = state.bitboards[OURS + p];
+    if constexpr (!GEN_CAPTURES) {
+        BB single_push = shift_one(pawns, UP) & ~occ;
+        BB dbl_push = shift_one(single_push, UP) & dbl_rank & ~occ;
+        single_push &= move_mask;
+        dbl_push &= move_mask;
+
+        BB push_pawns = pawns;
+        while (push_pawns) {
+            Square from_sq = pop_lsb(push_pawns);
+            BB allowed = get_bit(pinned, from_sq) ? line_table[king_sq][from_sq] : ~BB(0);
+
+            // Single push
+            Square to_sq = from_sq + UP_DELTA;
+            if (get_bit(single_push & allowed, to_sq)) {
+                if (get_bit(promo_rank, to_sq)) {
+                    Move move_no_promo = generate_move_nopromo(from_sq, to_sq);
+                    state.move_list.add((npromo << 12) | move_no_promo);
+                    state.move_list.add((bpromo << 12) | move_no_promo);
+                    state.move_list.add((rpromo << 12) | move_no_promo);
+                    state.move_list.add((qpromo << 12) | move_no_promo);
+                } else
+                    state.move_list.add(generate_move_nopromo(from_sq, to_sq));
+            }
 
-        // Single push
-        Square to_sq = from_sq - shifts[state.side_to_move];
-        if (get_bit(pawn_push_mask & move_mask, to_sq)) {
-            if (to_sq >= a8 || to_sq <= h1) {
-                Move move_no_promo = generate_move_nopromo(from_sq, to_sq);
-                state.move_list.add((npromo << 12) | move_no_promo);
-                state.move_list.add((bpromo << 12) | move_no_promo);
-                state.move_list.add((rpromo << 12) | move_no_promo);
-                state.move_list.add((qpromo << 12) | move_no_promo);
-            } else
+            // Dbl push
+            to_sq += UP_DELTA;
+            if (get_bit(dbl_push & allowed, to_sq))
                 state.move_list.add(generate_move_nopromo(from_sq, to_sq));
         }
-
-        // Dbl push
-        to_sq += shifts[state.side_to_move ^ 1];
-        if (get_bit(shift_one(pawn_push_mask, Dir(int(sout) ^ state.side_to_move)) & dbl_rank & ~occ & move_mask, to_sq))
-            state.move_list.add(generate_move_nopromo(from_sq, to_sq));
     }
 
     // Attacks
-    BB ep_mask = state.enpassant_square == no_square ? 0 : mask(state.enpassant_square);
-    BB targets = (opponent_pieces & move_mask) | ep_mask;
-    pawns = (state.bitboards[p] | state.bitboards[P]) & friendly_pieces;
+    BB targets = opponent_pieces & move_mask;
 
     while (pawns) {
         Square from_sq = pop_lsb(pawns);
 
-        BB movement_mask = pawn_attack_table[from_sq][state.side_to_move] & targets;
-        if (get_bit(all_inbetween, from_sq)) {
-            if (get_bit(dia_inbetween, from_sq)) movement_mask &= precomp_dia_fill[from_sq];
-            else if (get_bit(antdia_inbetween, from_sq)) movement_mask &= precomp_antdia_fill[from_sq];
-            else if (get_bit(hor_inbetween | ver_inbetween, from_sq)) movement_mask &= 0;
-        }
+        BB movement_mask = pawn_attack_table[from_sq][US] & targets;
+        if (get_bit(pinned, from_sq)) movement_mask &= line_table[king_sq][from_sq];
+
         while (movement_mask) {
             Square to_sq = pop_lsb(movement_mask);
 
-            if (to_sq == state.enpassant_square) {
-                if (null_if_check) {
-                    BB c_occ = occ;
-                    pop_bit(c_occ, from_sq);
-                    pop_bit(c_occ, (state.side_to_move == white ? to_sq - 8 : to_sq + 8));
-                    if (precomp_hor_fill[king_sq] & rook_moves(king_sq, c_occ) & opp_rooks) {
-                        // enpassant is not legal
-                        continue;
-                    }
-                } else
-                    if (!(mask(state.enpassant_square + (state.side_to_move == white ? -8 : 8)) & to_checkers_mask)
-                    && !(mask(state.enpassant_square) & to_checkers_mask)) continue;
-            }
-
-            if (to_sq >= a8 || to_sq <= h1) {
+            if (get_bit(promo_rank, to_sq)) {
                 Move move_no_promo = generate_move_nopromo(from_sq, to_sq);
                 state.move_list.add((c_npromo << 12) | move_no_promo);
                 state.move_list.add((c_bpromo << 12) | move_no_promo);
@@ -452,188 +511,177 @@ void Board::generate_moves() {
         }
     }
 
+    // En passant, checked by removing both pawns and looking for slider attacks on the king.
+    if (state.enpassant_square != no_square) {
+        constexpr Piece THEIRS = US == white ? p : P;
+        Square ep = state.enpassant_square;
+        Square cap_sq = ep - UP_DELTA;
+        BB ep_pawns = state.bitboards[OURS + p] & pawn_attack_table[ep][US ^ 1];
+        BB their_rooks = state.bitboards[THEIRS + r] | state.bitboards[THEIRS + q];
+        BB their_bishops = state.bitboards[THEIRS + b] | state.bitboards[THEIRS + q];
+        BB other_checkers = checkers & ~mask(cap_sq) & (state.bitboards[THEIRS + n] | state.bitboards[THEIRS + p]);
+
+        while (ep_pawns) {
+            Square from_sq = pop_lsb(ep_pawns);
+            BB c_occ = (occ ^ mask(from_sq) ^ mask(cap_sq)) | mask(ep);
+            if (other_checkers
+                || (rook_moves(king_sq, c_occ) & their_rooks)
+                || (bishop_moves(king_sq, c_occ) & their_bishops))
+                continue;
+
+            state.move_list.add(generate_move_nopromo(from_sq, ep));
+        }
+    }
+
     // Caslting
-    if (null_if_check && !GEN_CAPTURES) {
-        if (state.side_to_move == white) {
+    if constexpr (!GEN_CAPTURES) {
+        constexpr CastlingRights king_side = US == white ? wking_side : bking_side;
+        constexpr CastlingRights queen_side = US == white ? wqueen_side : bqueen_side;
+        constexpr Square king_start = US == white ? e1 : e8;
+        constexpr BB king_side_path = US == white ? mask(f1) | mask(g1) : mask(f8) | mask(g8);
+        constexpr BB queen_side_path = US == white ? mask(d1) | mask(c1) : mask(d8) | mask(c8);
+        constexpr BB queen_side_empty = queen_side_path | (US == white ? mask(b1) : mask(b8));
+
+        if (!checkers) {
             if (
                 // Can castle
-                (state.castling_rights & wking_side)
-                
-                // Squares king travel aren't attacked
-                && ((opp_any_attacks & (mask(f1) | mask(g1))) == 0)
+                (state.castling_rights & king_side)
                 
-                // There are no pieces between king & rook
-                
-                && ((occ & (mask(f1) | mask(g1))) == 0)
-                
-            )
-            state.move_list.add(generate_move_nopromo(e1, g1));
-
-            if (
-                // Can castle
-                (state.castling_rights & wqueen_side)
-
                 // Squares king travel aren't attacked
-                && ((opp_any_attacks & (mask(d1) | mask(c1))) == 0)
-
-                // There are no pieces between king & rook
-
-                && ((occ & (mask(d1) | mask(c1) | mask(b1))) == 0)
-            
-            )
-            state.move_list.add(generate_move_nopromo(e1, c1));
-
-        } else {
-            if (
-                // Can castle
-                (state.castling_rights & bking_side)
-
-                // Squares king travel aren't attacked
-                && ((opp_any_attacks & (mask(f8) | mask(g8))) == 0)
+                && ((opp_any_attacks & king_side_path) == 0)
                 
                 // There are no pieces between king & rook
-                
-                && ((occ & (mask(f8) | mask(g8))) == 0)
-            
+                && ((occ & king_side_path) == 0)
             )
-            state.move_list.add(generate_move_nopromo(e8, g8));
+            state.move_list.add(generate_move_nopromo(king_start, king_start + 2));
 
             if (
                 // Can castle
-                (state.castling_rights & bqueen_side)
+                (state.castling_rights & queen_side)
 
                 // Squares king travel aren't attacked
-                && ((opp_any_attacks & (mask(d8) | mask(c8))) == 0)
+                && ((opp_any_attacks & queen_side_path) == 0)
 
                 // There are no pieces between king & rook
-
-                && ((occ & (mask(d8) | mask(c8) | mask(b8))) == 0)
-            
+                && ((occ & queen_side_empty) == 0)
             )
-            state.move_list.add(generate_move_nopromo(e8, c8));
+            state.move_list.add(generate_move_nopromo(king_start, king_start - 2));
         }
     }
 
 }
 
-template void Board::generate_moves<CAPTURES>();
-template void Board::generate_moves<ALLMOVES>();
+template void Board::generate_moves<white, CAPTURES>();
+template void Board::generate_moves<white, ALLMOVES>();
+template void Board::generate_moves<black, CAPTURES>();
+template void Board::generate_moves<black, ALLMOVES>();
 
 void Board::make_null_move() {
     prev_state_idx++;
     prev_states[prev_state_idx] = state;
+    accumulators[prev_state_idx].computed = {};
+    key_history.push_back(state.hash_key);
     if (state.side_to_move == black) state.fullmove_counter++;
     state.side_to_move = state.side_to_move ^ 1;
     state.hash_key ^= zobrist::side_key;
+    if (state.enpassant_square != no_square) state.hash_key ^= zobrist::ep_file_key[get_file(state.enpassant_square)];
     state.enpassant_square = no_square;
     state.halfmove_clock = 0;
+
+    if (state.side_to_move == white) update_check_info<white>();
+    else update_check_info<black>();
 }
 
+template <Colour US>
 [[gnu::hot]]
 void Board::make_move(Move move) {
+    PROFILE_SCOPE(MAKE_MOVE);
+    constexpr Piece OURS = US == white ? P : p; // Offset of the friendly pieces
+    constexpr Piece THEIRS = US == white ? p : P; // Offset of the opponent pieces
+    constexpr Piece OUR_COLOUR = US == white ? wpieces : bpieces;
+    constexpr Piece THEIR_COLOUR = US == white ? bpieces : wpieces;
+    constexpr int UP_DELTA = US == white ? 8 : -8;
+    constexpr Square rook_ks_from = US == white ? h1 : h8, rook_ks_to = US == white ? f1 : f8;
+    constexpr Square rook_qs_from = US == white ? a1 : a8, rook_qs_to = US == white ? d1 : d8;
+
     prev_state_idx++;
     prev_states[prev_state_idx] = state;
+    accumulators[prev_state_idx].computed = {}; // Filled in lazily by the first NNUE evaluation.
+    key_history.push_back(state.hash_key);
     Key& key = state.hash_key;
     Square from_sq = get_from_sq(move), to_sq = get_to_sq(move);
     Piece piece = state.piece_list[from_sq];
-    Colour piece_colour = piece <= 5 ? bpieces : wpieces;
     Code move_code = get_code(move);
 
-    bool white_tm = state.side_to_move == white;
-    Colour c_piece_colour;
-    Square ep = state.enpassant_square, cap_sq;
-    key ^= zobrist::ep_file_key[get_file(ep)];
-    Piece promo_piece, c_piece;
+    Square ep = state.enpassant_square;
+    if (ep != no_square) key ^= zobrist::ep_file_key[get_file(ep)];
     state.enpassant_square = no_square;
 
     // Remove the captured piece.
     if (move_code == capture || move_code >= c_npromo) {
-        c_piece = state.piece_list[to_sq];
-        c_piece_colour = white_tm ? bpieces : wpieces;
+        Piece c_piece = state.piece_list[to_sq];
         pop_bit(state.bitboards[c_piece], to_sq);
-        pop_bit(state.bitboards[c_piece_colour], to_sq);
+        pop_bit(state.bitboards[THEIR_COLOUR], to_sq);
         key ^= zobrist::piece_keys[c_piece * 64 + to_sq];
+        state.psqt -= psqt_values[c_piece][to_sq];
+        state.phase -= phase_weights[c_piece];
+        if (c_piece == THEIRS + p) state.pawn_key ^= zobrist::piece_keys[c_piece * 64 + to_sq];
+        state.material_key ^= zobrist::piece_keys[c_piece * 64 + pop_count(state.bitboards[c_piece])];
     }
 
     // Remove the pawn.
     else if (move_code == epcapture) {
-        cap_sq = white_tm ? ep - 8 : ep + 8;
-        c_piece = white_tm ? p : P;
-        c_piece_colour = white_tm ? bpieces : wpieces;
-        pop_bit(state.bitboards[c_piece], cap_sq);
-        pop_bit(state.bitboards[c_piece_colour], cap_sq);
+        Square cap_sq = ep - UP_DELTA;
+        pop_bit(state.bitboards[THEIRS + p], cap_sq);
+        pop_bit(state.bitboards[THEIR_COLOUR], cap_sq);
         state.piece_list[cap_sq] = no_piece;
-        key ^= zobrist::piece_keys[c_piece * 64 + cap_sq];
+        key ^= zobrist::piece_keys[(THEIRS + p) * 64 + cap_sq];
+        state.psqt -= psqt_values[THEIRS + p][cap_sq];
+        state.pawn_key ^= zobrist::piece_keys[(THEIRS + p) * 64 + cap_sq];
+        state.material_key ^= zobrist::piece_keys[(THEIRS + p) * 64 + pop_count(state.bitboards[THEIRS + p])];
     }
 
     // Move the piece
     state.bitboards[piece] ^= mask(from_sq) | mask(to_sq);
-    state.bitboards[piece_colour] ^= mask(from_sq) | mask(to_sq);
+    state.bitboards[OUR_COLOUR] ^= mask(from_sq) | mask(to_sq);
     state.piece_list[from_sq] = no_piece;
     state.piece_list[to_sq] = piece;
     key ^= zobrist::piece_keys[piece * 64 + from_sq];
     key ^= zobrist::piece_keys[piece * 64 + to_sq];
+    state.psqt += psqt_values[piece][to_sq] - psqt_values[piece][from_sq];
+    if (piece == OURS + p)
+        state.pawn_key ^= zobrist::piece_keys[piece * 64 + from_sq] ^ zobrist::piece_keys[piece * 64 + to_sq];
 
     // Update enpassant sq.
     if (move_code == dbpush) {
-        state.enpassant_square = white_tm ? to_sq - 8 : to_sq + 8;
+        state.enpassant_square = to_sq - UP_DELTA;
         key ^= zobrist::ep_file_key[get_file(state.enpassant_square)];
     }
 
     else if (move_code == kcastle) {
         // Move the rook.
-        if (white_tm) {
-            state.bitboards[R] ^= mask(h1) | mask(f1);
-            state.bitboards[wpieces] ^= mask(h1) | mask(f1);
-            key ^= zobrist::piece_keys[R * 64 + h1];
-            key ^= zobrist::piece_keys[R * 64 + f1];
-            state.piece_list[h1] = no_piece;
-            state.piece_list[f1] = R;
-        } else {
-            state.bitboards[r] ^= mask(h8) | mask(f8);
-            state.bitboards[bpieces] ^= mask(h8) | mask(f8);
-            key ^= zobrist::piece_keys[r * 64 + h8];
-            key ^= zobrist::piece_keys[r * 64 + f8];
-            state.piece_list[h8] = no_piece;
-            state.piece_list[f8] = r;
-        }
+        state.bitboards[OURS + r] ^= mask(rook_ks_from) | mask(rook_ks_to);
+        state.bitboards[OUR_COLOUR] ^= mask(rook_ks_from) | mask(rook_ks_to);
+        key ^= zobrist::piece_keys[(OURS + r) * 64 + rook_ks_from];
+        key ^= zobrist::piece_keys[(OURS + r) * 64 + rook_ks_to];
+        state.piece_list[rook_ks_from] = no_piece;
+        state.piece_list[rook_ks_to] = OURS + r;
+        state.psqt += psqt_values[OURS + r][rook_ks_to] - psqt_values[OURS + r][rook_ks_from];
     }
 
     else if (move_code == qcastle) {
-        if (white_tm) {
-            state.bitboards[R] ^= mask(a1) | mask(d1);
-            state.bitboards[wpieces] ^= mask(a1) | mask(d1);
-            key ^= zobrist::piece_keys[R * 64 + a1];
-            key ^= zobrist::piece_keys[R * 64 + d1];
-            state.piece_list[a1] = no_piece;
-            state.piece_list[d1] = R;
-        } else {
-            state.bitboards[r] ^= mask(a8) | mask(d8);
-            state.bitboards[bpieces] ^= mask(a8) | mask(d8);
-            key ^= zobrist::piece_keys[r * 64 + a8];
-            key ^= zobrist::piece_keys[r * 64 + d8];
-            state.piece_list[a8] = no_piece;
-            state.piece_list[d8] = r;
-        }
+        state.bitboards[OURS + r] ^= mask(rook_qs_from) | mask(rook_qs_to);
+        state.bitboards[OUR_COLOUR] ^= mask(rook_qs_from) | mask(rook_qs_to);
+        key ^= zobrist::piece_keys[(OURS + r) * 64 + rook_qs_from];
+        key ^= zobrist::piece_keys[(OURS + r) * 64 + rook_qs_to];
+        state.piece_list[rook_qs_from] = no_piece;
+        state.piece_list[rook_qs_to] = OURS + r;
+        state.psqt += psqt_values[OURS + r][rook_qs_to] - psqt_values[OURS + r][rook_qs_from];
     }
 
     else if (move_code >= npromo) {
-        switch (move_code)
-        {
-            case c_npromo:
-            case npromo: promo_piece = white_tm ? N : n; break;
-            
-            case c_bpromo:
-            case bpromo: promo_piece = white_tm ? B : b; break;
-            
-            case c_rpromo:
-            case rpromo: promo_piece = white_tm ? R : r; break;
-            
-            case c_qpromo:
-            case qpromo: promo_piece = white_tm ? Q : q; break;
-            default:
-            break;
-        }
+        // The low two bits of the code select the piece, n b r q.
+        Piece promo_piece = OURS + n + (move_code & 3);
 
         // Remove the pawn.
         pop_bit(state.bitboards[piece], to_sq);
@@ -643,6 +691,11 @@ void Board::make_move(Move move) {
         set_bit(state.bitboards[promo_piece], to_sq);
         state.piece_list[to_sq] = promo_piece;
         key ^= zobrist::piece_keys[promo_piece * 64 + to_sq];
+        state.psqt += psqt_values[promo_piece][to_sq] - psqt_values[piece][to_sq];
+        state.phase += phase_weights[promo_piece];
+        state.pawn_key ^= zobrist::piece_keys[piece * 64 + to_sq];
+        state.material_key ^= zobrist::piece_keys[piece * 64 + pop_count(state.bitboards[piece])];
+        state.material_key ^= zobrist::piece_keys[promo_piece * 64 + pop_count(state.bitboards[promo_piece]) - 1];
     }
 
     // Castling rights
@@ -665,33 +718,69 @@ void Board::make_move(Move move) {
     }
 
     // Update counters and side to move
-    if (state.side_to_move == black) state.fullmove_counter++;
-    state.halfmove_clock = (move_code == capture || piece == p || piece == P) ? 0 : state.halfmove_clock + 1;
+    if constexpr (US == black) state.fullmove_counter++;
+    state.halfmove_clock = (move_code == capture || piece == OURS + p) ? 0 : state.halfmove_clock + 1;
 
-    state.side_to_move ^= 1;
+    state.side_to_move = US ^ 1;
     key ^= zobrist::side_key;
 
     // Recalculate all-piece sets
     state.bitboards[allpieces] = state.bitboards[bpieces] | state.bitboards[wpieces];
+
+    update_check_info<US ^ 1>();
 }
 
+template void Board::make_move<white>(Move move);
+template void Board::make_move<black>(Move move);
+
 [[gnu::hot]]
 void Board::unmake_last_move() {
+    PROFILE_SCOPE(UNMAKE_MOVE);
     state = prev_states[prev_state_idx];
     prev_state_idx--;
+    key_history.pop_back();
 }
 
-bool Board::is_rep() {
+bool Board::is_rep(int ply) {
     if (state.halfmove_clock >= 50) return true;
 
-    int repetition_count = 1; // include current state
-    Key current_key = state.hash_key;
-    for (const auto& prev : prev_states) {
-        if (prev.hash_key == current_key)
-            repetition_count++;
+    // Only positions with the same side to move since the last irreversible move can repeat.
+    // The closest candidate is 4 plies back.
+    int size = key_history.size();
+    int end = std::min(state.halfmove_clock, size);
+    int repetition_count = 0;
+    for (int i = 4; i <= end; i += 2) {
+        if (key_history[size - i] != state.hash_key) continue;
+
+        // A repetition inside the search path is a draw, before the root it needs to be a threefold.
+        if (i < ply || ++repetition_count == 2) return true;
     }
 
-    if (repetition_count > 2) return true;
+    return false;
+}
+
+bool Board::is_upcoming_rep(int ply) {
+    int size = key_history.size();
+    int end = std::min(state.halfmove_clock, size);
+    if (end < 3) return false;
+
+    BB occ = state.bitboards[allpieces];
+    for (int i = 3; i <= end; i += 2) {
+        // Positions before the root would need a threefold, only the search path is considered.
+        if (i >= ply) break;
+
+        Key move_key = state.hash_key ^ key_history[size - i];
+        int idx = cuckoo::h1(move_key);
+        if (cuckoo::keys[idx] != move_key) {
+            idx = cuckoo::h2(move_key);
+            if (cuckoo::keys[idx] != move_key) continue;
+        }
+
+        // The reversible move must not be blocked.
+        Move move = cuckoo::moves[idx];
+        if ((between_table[get_from_sq(move)][get_to_sq(move)] & occ) == 0)
+            return true;
+    }
 
     return false;
 }
@@ -707,20 +796,21 @@ BB Board::get_least_valuable_piece(BB attackdef, Colour side, Piece& piece) {
     return 0;
 }
 
-std::array<Score, 6> material = { 100, 320, 330, 500, 900, 1000};
+std::array<Score, 6> see_material = { 100, 320, 330, 500, 900, 1000};
 
 Score Board::see(Square to_sq, Piece target, Square from_sq, Piece att_piece) {
+    PROFILE_SCOPE(SEE);
     std::array<Score, 32> gain;
     int d = 0;
     BB fromBB = mask(from_sq);
     BB occ = state.bitboards[allpieces];
     BB attackdef = sq_attacked_by(occ, to_sq);
     Colour side = target < 6 ? white : black;
-    gain[d] = material[target > 5 ? target - 6 : target];
+    gain[d] = see_material[target > 5 ? target - 6 : target];
 
     do {
         d++;
-        gain[d] = material[att_piece > 5 ? att_piece - 6 : att_piece] - gain[d - 1];
+        gain[d] = see_material[att_piece > 5 ? att_piece - 6 : att_piece] - gain[d - 1];
         attackdef ^= fromBB;
         occ ^= fromBB;
         side ^= 1;
@@ -0,0 +1,45 @@
+#include <cassert>
+#include <utility>
+
+#include "../include/board.hpp"
+
+using namespace move_generator;
+
+void cuckoo::init() {
+    keys.fill(0);
+    moves.fill(nullmove);
+    [[maybe_unused]] int count = 0;
+
+    for (Piece piece : { N, B, R, Q, K, n, b, r, q, k }) {
+        for (Square sq1 = 0; sq1 < 64; ++sq1) {
+            BB attacks = 0;
+            switch (piece % 6) {
+                case n: attacks = knight_move_table[sq1]; break;
+                case b: attacks = bishop_moves(sq1, 0); break;
+                case r: attacks = rook_moves(sq1, 0); break;
+                case q: attacks = bishop_moves(sq1, 0) | rook_moves(sq1, 0); break;
+                case k: attacks = king_move_table[sq1]; break;
+            }
+
+            for (Square sq2 = sq1 + 1; sq2 < 64; ++sq2) {
+                if (!get_bit(attacks, sq2)) continue;
+
+                Move move = sq1 | (sq2 << 6);
+                Key key = zobrist::piece_keys[piece * 64 + sq1] ^ zobrist::piece_keys[piece * 64 + sq2] ^ zobrist::side_key;
+
+                // Cuckoo insertion, displaced entries move to their other slot.
+                int idx = h1(key);
+                while (true) {
+                    std::swap(keys[idx], key);
+                    std::swap(moves[idx], move);
+                    if (move == nullmove) break;
+                    idx = (idx == h1(key)) ? h2(key) : h1(key);
+                }
+
+                count++;
+            }
+        }
+    }
+
+    assert(count == 3668);
+}
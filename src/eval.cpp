@@ -1,237 +1,308 @@
 #include "../include/eval.hpp"
 #include "../include/globals.hpp"
+#include "../include/eval_cache.hpp"
+#include "../include/material.hpp"
+#include "../include/nnue.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
 
 using namespace bb_math;
+using namespace move_generator;
 
-Score Board::eval_pawns() {
-    bool is_endgame = 
-    pop_count(state.bitboards[allpieces] ^ (state.bitboards[p] | state.bitboards[P] | state.bitboards[k] | state.bitboards[K]))
-    <= 7;
-    Score score = 0;
+namespace {
+    // Each term of one side, from that side's view. The Board::eval_ functions combine both sides.
 
-    BB wpawns = state.bitboards[P];
-    BB bpawns = state.bitboards[p];
-    BB copy_bb;
-
-    // Material.
-    score += material[p] * pop_count(wpawns);  
-    score -= material[p] * pop_count(bpawns);          
-    
-    // PSQT.
-    int table = is_endgame ? 1 : 0;
-    copy_bb = wpawns;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score += pawn_psqt[table][flip_rank(sq)];
-    }
+    PhaseScore pawn_structure(BB pawns, BB their_pawns, Colour us) {
+        PhaseScore score;
 
-    copy_bb = bpawns;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score -= pawn_psqt[table][sq];
-    }
+        // Doubled.
+        BB pawns_infront_behind = pawns & (us == white ? wrear_span(pawns) : brear_span(pawns));
+        score += DBL_PAWNS_PEN * (pop_count(pawns_infront_behind) / 2);
 
-    // Doubled.
-    BB wpawns_infront_behind = wpawns & wrear_span(wpawns);
-    BB bpawns_infront_behind = bpawns & brear_span(bpawns);
+        // Triples.
+        pawns_infront_behind &= pawns & (us == white ? wfront_span(pawns) : bfront_span(pawns));
+        score += TRI_PAWNS_PEN * (pop_count(file_fill(pawns_infront_behind)) / 3);
 
-    int num_doubled = pop_count(wpawns_infront_behind) / 2;
-    score += DBL_PAWNS_PEN * num_doubled;
+        // Passed.
+        BB passed = us == white ? wpassed_pawns(pawns, their_pawns) : bpassed_pawns(pawns, their_pawns);
+        score += PASS_PAWNS_BONUS * pop_count(passed);
 
-    num_doubled = pop_count(bpawns_infront_behind) / 2;
-    score -= DBL_PAWNS_PEN * num_doubled;
+        // Isolated and half isolated.
+        score += ISO_PAWNS_PEN * pop_count(isolanis(pawns));
+        score += HALF_ISO_PAWNS_PEN * pop_count(half_isolanis(pawns));
 
-    // Triples.
-    wpawns_infront_behind &= wpawns & wfront_span(wpawns);
-    bpawns_infront_behind &= bpawns & bfront_span(bpawns);
+        return score;
+    }
 
-    BB file_with_triple = file_fill(wpawns_infront_behind);
+    PhaseScore rook_files(const PawnEntry& pawn_entry, BB rooks, Colour us) {
+        // Rooks on open and semi-open files.
+        return OPEN_FILE_ROOKS_BONUS * pop_count(pawn_entry.open_files & rooks)
+             + HALF_OPEN_FILE_ROOKS_BONUS * pop_count(pawn_entry.half_open_files[us] & rooks);
+    }
 
-    int num_tripled = pop_count(file_with_triple) / 3;
-    score += TRI_PAWNS_PEN * num_tripled;
+    PhaseScore mobility(const AttackInfo& attacks, Colour us) {
+        return KNIGHT_MOBILITY_BONUS * attacks.mobility[us][0] + BISHOP_MOBILITY_BONUS * attacks.mobility[us][1]
+             + ROOK_MOBILITY_BONUS * attacks.mobility[us][2] + QUEEN_MOBILITY_BONUS * attacks.mobility[us][3];
+    }
 
-    file_with_triple = file_fill(bpawns_infront_behind);
-    num_tripled = pop_count(file_with_triple) / 3;
-    score -= TRI_PAWNS_PEN * num_tripled;
+    PhaseScore king_zone_attacks(const AttackInfo& attacks, Colour us) {
+        return KING_ZONE_ATTACK_BONUS * attacks.king_zone_attacks[us];
+    }
 
-    // Passed.
-    int num_passed = pop_count(wpassed_pawns(wpawns, bpawns));
-    score += num_passed * PASS_PAWNS_BONUS;
+    PhaseScore threats(const BoardState& state, const AttackInfo& attacks, Colour us) {
+        Piece ours = us == white ? P : p;
+        Piece theirs = us == white ? p : P;
+        BB their_pieces = state.bitboards[theirs + n] | state.bitboards[theirs + b]
+                        | state.bitboards[theirs + r] | state.bitboards[theirs + q];
+        BB their_majors = state.bitboards[theirs + r] | state.bitboards[theirs + q];
+
+        // Pieces attacked by pawns, majors attacked by minors, and pieces left undefended.
+        PhaseScore score = PAWN_THREAT_BONUS * pop_count(attacks.by_piece[ours + p] & their_pieces);
+        score += MINOR_THREAT_BONUS * pop_count((attacks.by_piece[ours + n] | attacks.by_piece[ours + b]) & their_majors);
+        score += HANGING_PIECE_BONUS * pop_count(their_pieces & attacks.by_side[us] & ~attacks.by_side[us ^ 1]);
+        return score;
+    }
 
-    num_passed = pop_count(bpassed_pawns(bpawns, wpawns));
-    score -= num_passed * PASS_PAWNS_BONUS;
+    // Known endgames replace the generic terms. Every signature the material table
+    // recognises has a lone king or at most a rook's worth of phase on the board.
+    const MaterialEntry generic_entry;
 
-    // Isolated.
-    int num_isolated = pop_count(isolanis(wpawns));
-    score += ISO_PAWNS_PEN * num_isolated;
+    const MaterialEntry& probe_material(const BoardState& state) {
+        bool has_lone_king = pop_count(state.bitboards[wpieces]) == 1 || pop_count(state.bitboards[bpieces]) == 1;
+        return (state.phase <= phase_weights[R] || has_lone_king)
+            ? material_table.probe(state.material_key, state) : generic_entry;
+    }
+}
 
-    num_isolated = pop_count(isolanis(bpawns));
-    score -= ISO_PAWNS_PEN * num_isolated;
+const PawnEntry& Board::eval_pawns() {
+    PawnEntry& entry = pawn_hash.probe(state.pawn_key);
+    if (entry.key == state.pawn_key) return entry;
 
-    // Half isolated.
-    int num_half_isolated = pop_count(half_isolanis(wpawns));
-    score += HALF_ISO_PAWNS_PEN * num_half_isolated;
+    BB wpawns = state.bitboards[P];
+    BB bpawns = state.bitboards[p];
+    entry.score = pawn_structure(wpawns, bpawns, white) - pawn_structure(bpawns, wpawns, black);
 
-    num_half_isolated = pop_count(half_isolanis(bpawns));
-    score -= HALF_ISO_PAWNS_PEN * num_half_isolated;
+    // Files for the rook terms.
+    entry.open_files = open_file(wpawns, bpawns);
+    entry.half_open_files[white] = w_half_open_files(wpawns, bpawns);
+    entry.half_open_files[black] = b_half_open_files(wpawns, bpawns);
 
-    return score;
+    entry.key = state.pawn_key;
+    return entry;
 }
 
-Score Board::eval_knights() {
-    Score score = 0;
-
-    BB wknights = state.bitboards[N];
-    BB bknights = state.bitboards[n];
-    BB copy_bb;
-
-    score += material[n] * pop_count(wknights);
-    score -= material[n] * pop_count(bknights);
+PhaseScore Board::eval_rooks(const PawnEntry& pawn_entry) {
+    return rook_files(pawn_entry, state.bitboards[R], white) - rook_files(pawn_entry, state.bitboards[r], black);
+}
 
-    copy_bb = wknights;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score += knight_psqt[flip_rank(sq)];
-    }
-    
-    copy_bb = bknights;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score -= knight_psqt[sq];
+AttackInfo compute_attacks(const BoardState& state) {
+    AttackInfo info;
+    BB occ = state.bitboards[allpieces];
+    info.by_piece[p] = bpawn_attacks(state.bitboards[p]);
+    info.by_piece[P] = wpawn_attacks(state.bitboards[P]);
+    info.by_piece[k] = king_attacks(state.bitboards[k]);
+    info.by_piece[K] = king_attacks(state.bitboards[K]);
+
+    for (Colour us : { black, white }) {
+        Piece ours = us == white ? P : p;
+        Piece theirs = us == white ? p : P;
+        BB mobility_area = ~state.bitboards[bpieces + us] & ~info.by_piece[theirs + p];
+        BB king_zone = info.by_piece[theirs + k] | state.bitboards[theirs + k];
+
+        for (Piece type = n; type <= q; ++type) {
+            BB pieces = state.bitboards[ours + type];
+            while (pieces) {
+                Square sq = pop_lsb(pieces);
+                BB attacks = type == n ? knight_move_table[sq]
+                           : type == b ? bishop_moves(sq, occ)
+                           : type == r ? rook_moves(sq, occ)
+                           : bishop_moves(sq, occ) | rook_moves(sq, occ);
+
+                info.by_piece[ours + type] |= attacks;
+                info.mobility[us][type - n] += pop_count(attacks & mobility_area);
+                info.king_zone_attacks[us] += pop_count(attacks & king_zone);
+            }
+        }
     }
 
-    return score;
+    for (Piece piece = p; piece <= K; ++piece) info.by_side[piece >= P] |= info.by_piece[piece];
+    return info;
 }
 
-Score Board::eval_bishops() {
-    Score score = 0;
+PhaseScore Board::eval_mobility(const AttackInfo& attacks) {
+    return mobility(attacks, white) - mobility(attacks, black);
+}
+
+PhaseScore Board::eval_king_safety(const AttackInfo& attacks) {
+    return king_zone_attacks(attacks, white) - king_zone_attacks(attacks, black);
+}
 
-    BB wbishops = state.bitboards[B];
-    BB bbishops = state.bitboards[b];
-    BB copy_bb;
+PhaseScore Board::eval_threats(const AttackInfo& attacks) {
+    return threats(state, attacks, white) - threats(state, attacks, black);
+}
 
-    score += material[b] * pop_count(wbishops);
-    score -= material[b] * pop_count(bbishops);
+PhaseScore Board::eval_psqt() {
+    PhaseScore score;
 
-    copy_bb = wbishops;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score += bishop_psqt[flip_rank(sq)];
-    }
-    
-    copy_bb = bbishops;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score -= bishop_psqt[sq];
+    for (Piece piece = p; piece <= K; ++piece) {
+        BB copy_bb = state.bitboards[piece];
+        while (copy_bb) {
+            Square sq = pop_lsb(copy_bb);
+            score += psqt_values[piece][sq];
+        }
     }
 
     return score;
 }
 
-Score Board::eval_rooks() {
-    Score score = 0;
+int Board::eval_phase() {
+    int phase = 0;
 
-    BB wrooks = state.bitboards[R];
-    BB brooks = state.bitboards[r];
-    BB copy_bb;
+    for (Piece piece = p; piece <= K; ++piece)
+        phase += phase_weights[piece] * pop_count(state.bitboards[piece]);
 
-    score += material[r] * pop_count(wrooks);
-    score -= material[r] * pop_count(brooks);
+    return phase;
+}
 
-    copy_bb = wrooks;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score += rook_psqt[flip_rank(sq)];
-    }
-    
-    copy_bb = brooks;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score -= rook_psqt[sq];
+Score Board::eval() {
+    PROFILE_SCOPE(EVAL);
+    // Material, PSQT and phase are accumulated in make_move.
+    assert(state.psqt == eval_psqt());
+    assert(state.phase == eval_phase());
+    assert(state.pawn_key == zobrist::gen_pawn_key(state));
+    assert(state.material_key == zobrist::gen_material_key(state));
+
+    const MaterialEntry& material_entry = probe_material(state);
+
+    if (material_entry.dead_draw) return 0;
+    if (material_entry.evaluator) {
+        Score score = material_entry.evaluator(state, material_entry.strong_side);
+        return (state.side_to_move == material_entry.strong_side) ? score : -score;
     }
 
-    // Rooks on open files.
-    BB wpawns = state.bitboards[P];
-    BB bpawns = state.bitboards[p];
-    int num_rooks_on_open = pop_count(open_file(wpawns, bpawns) & wrooks);
-    score += OPEN_FILE_ROOKS_BONUS * num_rooks_on_open;
+    if (nnue::is_enabled()) return eval_nnue();
 
-    num_rooks_on_open = pop_count(open_file(wpawns, bpawns) & brooks);
-    score -= OPEN_FILE_ROOKS_BONUS * num_rooks_on_open;
+    const PawnEntry& pawn_entry = eval_pawns();
+    PhaseScore score = state.psqt;
+    score += pawn_entry.score;
+    score += eval_rooks(pawn_entry);
 
-    // Rooks on semi-open files.
-    int num_rooks_on_semi_open = pop_count(w_half_open_files(wpawns, bpawns) & wrooks);
-    score += HALF_OPEN_FILE_ROOKS_BONUS * num_rooks_on_semi_open;
+    AttackInfo attacks = compute_attacks(state);
+    score += eval_mobility(attacks);
+    score += eval_king_safety(attacks);
+    score += eval_threats(attacks);
 
-    num_rooks_on_semi_open = pop_count(b_half_open_files(wpawns, bpawns) & brooks);
-    score -= HALF_OPEN_FILE_ROOKS_BONUS * num_rooks_on_semi_open;
+    // Scale down the endgame score of the side ahead in drawish material.
+    score.eg = score.eg * material_entry.scale_factor(state, score.eg > 0 ? white : black) / SCALE_NORMAL;
 
-    return score;
+    // Interpolate between the middlegame and endgame scores.
+    int phase = std::min(state.phase, MAX_PHASE);
+    Score tapered = (score.mg * phase + score.eg * (MAX_PHASE - phase)) / MAX_PHASE;
+
+    return (state.side_to_move == white) ? tapered : -tapered;
 }
 
-Score Board::eval_queens() {
-    Score score = 0;
+EvalTrace Board::trace_eval() {
+    EvalTrace trace;
+    const PawnEntry& pawn_entry = eval_pawns();
+    AttackInfo attacks = compute_attacks(state);
+
+    for (Colour us : { black, white }) {
+        Piece ours = us == white ? P : p;
+        Piece theirs = us == white ? p : P;
+
+        // psqt_values holds material and PSQT together, negated for black.
+        PhaseScore& material_score = trace.terms[EvalTrace::MATERIAL][us];
+        PhaseScore& psqt_score = trace.terms[EvalTrace::PSQT][us];
+        for (Piece type = p; type <= k; ++type) {
+            BB pieces = state.bitboards[ours + type];
+            if (type != k) material_score += PhaseScore{ material[type], material[type] } * pop_count(pieces);
+            while (pieces) {
+                Square sq = pop_lsb(pieces);
+                psqt_score += us == white ? psqt_values[ours + type][sq] : -psqt_values[ours + type][sq];
+            }
+        }
+        psqt_score -= material_score;
+
+        trace.terms[EvalTrace::PAWNS][us] = pawn_structure(state.bitboards[ours + p], state.bitboards[theirs + p], us);
+        trace.terms[EvalTrace::ROOKS][us] = rook_files(pawn_entry, state.bitboards[ours + r], us);
+        trace.terms[EvalTrace::MOBILITY][us] = mobility(attacks, us);
+        trace.terms[EvalTrace::KING_SAFETY][us] = king_zone_attacks(attacks, us);
+        trace.terms[EvalTrace::THREATS][us] = threats(state, attacks, us);
+    }
 
-    BB wqueens = state.bitboards[Q];
-    BB bqueens = state.bitboards[q];
-    BB copy_bb;
+    PhaseScore total;
+    for (const std::array<PhaseScore, 2>& term : trace.terms) total += term[white] - term[black];
 
-    score += material[q] * pop_count(wqueens);
-    score -= material[q] * pop_count(bqueens);
+    const MaterialEntry& material_entry = probe_material(state);
+    trace.phase = std::min(state.phase, MAX_PHASE);
+    trace.scale = material_entry.scale_factor(state, total.eg > 0 ? white : black);
+    trace.source = material_entry.dead_draw ? EvalTrace::DEAD_DRAW
+                 : material_entry.evaluator ? EvalTrace::ENDGAME_EVALUATOR
+                 : nnue::is_enabled() ? EvalTrace::NETWORK : EvalTrace::TERMS;
 
-    copy_bb = wqueens;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score += queen_psqt[flip_rank(sq)];
-    }
-    
-    copy_bb = bqueens;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score -= queen_psqt[sq];
-    }
-
-    return score;
+    Score score = eval();
+    trace.score = state.side_to_move == white ? score : -score;
+    return trace;
 }
 
-Score Board::eval_kings() {
+/// Brings the accumulator of perspective up to date from the closest computed one on the search path.
+void Board::update_accumulator(Colour perspective) {
+    // The position at index i of the path is prev_states[i + 1], the current one is state.
+    auto position = [&](size_t i) -> const BoardState& { return i == prev_state_idx ? state : prev_states[i + 1]; };
+    Piece king = perspective == white ? K : k;
+
+    // Every feature depends on the king square, past a move of that king the accumulator is rebuilt.
+    size_t i = prev_state_idx;
+    while (i > 0 && !accumulators[i].computed[perspective]
+           && position(i).bitboards[king] == position(i - 1).bitboards[king])
+        i--;
 
-    bool is_endgame = 
-    pop_count(state.bitboards[allpieces] ^ (state.bitboards[p] | state.bitboards[P] | state.bitboards[k] | state.bitboards[K]))
-    <= 7;
-    
-    Score score = 0;
+    if (!accumulators[i].computed[perspective]) nnue::refresh(accumulators[i], position(i), perspective);
 
-    BB wkings = state.bitboards[K];
-    BB bkings = state.bitboards[k];
-    BB copy_bb;
+    for (++i; i <= prev_state_idx; ++i)
+        nnue::update(accumulators[i], accumulators[i - 1], position(i), position(i - 1), perspective);
+}
 
-    int table = is_endgame ? 1 : 0;
+Score Board::eval_nnue() {
+    nnue::Accumulator& acc = accumulators[prev_state_idx];
+    for (Colour perspective : { black, white })
+        if (!acc.computed[perspective]) update_accumulator(perspective);
 
-    copy_bb = wkings;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score += king_psqt[table][flip_rank(sq)];
-    }
-    
-    copy_bb = bkings;
-    while (copy_bb) {
-        Square sq = pop_lsb(copy_bb);
-        score -= king_psqt[table][sq];
+    return nnue::evaluate(acc, state.side_to_move);
+}
+
+Score Board::probe_eval() {
+    EvalEntry& entry = eval_cache.probe(state.hash_key);
+    if (entry.key == state.hash_key) {
+        assert(entry.score == eval());
+        return entry.score;
     }
 
-    return score;
+    entry.key = state.hash_key;
+    entry.score = eval();
+    return entry.score;
 }
 
-Score Board::eval() {
-    Score score = 0;
+bool Board::is_known_draw() {
+    // Dead draws have at most one minor piece besides the kings.
+    return pop_count(state.bitboards[allpieces]) <= 3 && material_table.probe(state.material_key, state).dead_draw;
+}
+
+/// @brief Looks up king and pawn against king in the bitbase.
+/// @param score Set to 0 for a draw, or +-KNOWN_WIN from the side to move's view.
+/// @return Whether the position is in the bitbase.
+bool Board::probe_bitbase(Score& score) {
+    BB pawns = state.bitboards[P] | state.bitboards[p];
+    if (pop_count(state.bitboards[allpieces]) != 3 || pop_count(pawns) != 1) return false;
 
-    score += eval_pawns();
-    score += eval_knights();
-    score += eval_bishops();
-    score += eval_rooks();
-    score += eval_queens();
-    score += eval_kings();
+    Colour strong = state.bitboards[P] ? white : black;
+    Square strong_king = bitscan_forward(state.bitboards[strong == white ? K : k]);
+    Square weak_king = bitscan_forward(state.bitboards[strong == white ? k : K]);
+    bool win = bitbase::probe_kpk(strong_king, bitscan_forward(pawns), weak_king, strong, state.side_to_move);
 
-    return (state.side_to_move == white) ? score : -score;
+    score = !win ? 0 : state.side_to_move == strong ? KNOWN_WIN : -KNOWN_WIN;
+    return true;
 }
\ No newline at end of file
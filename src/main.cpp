@@ -2,22 +2,54 @@
 #include <optional>
 #include <iostream>
 #include <filesystem>
+#include <thread>
 
 #include "../include/uci.hpp"
 #include "../include/board.hpp"
 #include "../include/transposition.hpp"
 #include "../include/book.hpp"
+#include "../include/tablebase.hpp"
+#include "../include/nnue.hpp"
+#include "../include/tune.hpp"
+#include "../include/batch.hpp"
 
 #include "../include/utils.hpp"
 
 Board game_board;
 std::optional<Transposition> game_table;
 std::filesystem::path book_path;
+std::filesystem::path tb_path;
+std::filesystem::path nnue_path;
 
 int main(int argc, char* argv[]) {
     std::filesystem::path exe_path = argv[0];
     std::filesystem::path exe_dir = exe_path.parent_path();
     book_path = exe_dir / "book.bin";
+    tb_path = exe_dir / "tb";
+    nnue_path = exe_dir / "nn.nnue";
+
+    // Offline tablebase generation: Engine gentb <material> [threads]
+    if (argc >= 3 && std::string(argv[1]) == "gentb") {
+        int threads = argc >= 4 ? std::stoi(argv[3]) : std::thread::hardware_concurrency();
+        return tablebase::generate(argv[2], threads) ? 0 : 1;
+    }
+
+    // Texel tuning of the evaluation terms: Engine tune <dataset.epd> [threads] [epochs]
+    if (argc >= 3 && std::string(argv[1]) == "tune") {
+        int threads = argc >= 4 ? std::stoi(argv[3]) : std::thread::hardware_concurrency();
+        int epochs = argc >= 5 ? std::stoi(argv[4]) : 500;
+        return tuner::tune(argv[2], std::max(threads, 1), epochs) ? 0 : 1;
+    }
+
+    nnue::load(nnue_path);
+
+    // Static evaluation of a file of FENs: Engine evalfile <in> <out> [threads]
+    if (argc >= 4 && std::string(argv[1]) == "evalfile") {
+        int threads = argc >= 5 ? std::stoi(argv[4]) : std::thread::hardware_concurrency();
+        return batch::eval_file(argv[2], argv[3], std::max(threads, 1)) ? 0 : 1;
+    }
+
+    tablebase::init(tb_path);
 
     std::string line;
     bool quit = false;
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "../include/material.hpp"
+#include "../include/bitbase.hpp"
+#include "../include/board.hpp"
+#include "../include/eval.hpp"
+
+using namespace bb_math;
+
+namespace {
+    inline constexpr BB DARK_SQUARES = 0xAA55AA55AA55AA55ULL;
+
+    inline Square relative_sq(Square sq, Colour side) { return side == white ? sq : flip_rank(sq); }
+
+    inline bool is_dark(Square sq) { return get_bit(DARK_SQUARES, sq); }
+
+    /// Larger the closer sq is to the edge of the board.
+    inline Score push_to_edge(Square sq) {
+        int file = get_file(sq), rank = get_rank(sq);
+        return 10 * ((3 - std::min(file, 7 - file)) + (3 - std::min(rank, 7 - rank)));
+    }
+
+    /// Larger the closer the two squares are.
+    inline Score push_close(Square sq1, Square sq2) { return 20 * (7 - distance(sq1, sq2)); }
+
+    inline Square king_sq(const BoardState& state, Colour side) {
+        return bitscan_forward(state.bitboards[side == white ? K : k]);
+    }
+
+    inline Score non_pawn_material(const BoardState& state, Colour side) {
+        Piece offset = side == white ? P : p;
+        return material[n] * pop_count(state.bitboards[offset + n])
+             + material[b] * pop_count(state.bitboards[offset + b])
+             + material[r] * pop_count(state.bitboards[offset + r])
+             + material[q] * pop_count(state.bitboards[offset + q]);
+    }
+}
+
+void init_material_entry(MaterialEntry& entry, const BoardState& state) {
+    std::array<int, 12> counts{};
+    for (Piece piece = p; piece <= K; ++piece)
+        counts[piece] = pop_count(state.bitboards[piece]);
+
+    // Insufficient material, no sequence of moves leads to mate.
+    int minors = counts[n] + counts[b] + counts[N] + counts[B];
+    int others = counts[p] + counts[r] + counts[q] + counts[P] + counts[R] + counts[Q];
+    if (others == 0 && minors <= 1) {
+        entry.dead_draw = true;
+        entry.scale = { SCALE_DRAW, SCALE_DRAW };
+        return;
+    }
+
+    for (Colour strong : { black, white }) {
+        Colour weak = strong ^ 1;
+        Piece us = strong == white ? P : p;
+        Piece them = weak == white ? P : p;
+        Score strong_npm = non_pawn_material(state, strong);
+        Score weak_npm = non_pawn_material(state, weak);
+
+        // Without pawns a single minor, or two knights, cannot force mate.
+        if (counts[us + p] == 0 && (strong_npm <= material[b] || (strong_npm == 2 * material[n] && counts[us + n] == 2)))
+            entry.scale[strong] = SCALE_DRAW;
+
+        // Endgames against a lone king.
+        if (weak_npm == 0 && counts[them + p] == 0) {
+            if (strong_npm == 0 && counts[us + p] == 1) {
+                entry.evaluator = endgame::kpk;
+                entry.strong_side = strong;
+            } else if (counts[us + p] == 0 && counts[us + n] == 1 && counts[us + b] == 1 && strong_npm == material[n] + material[b]) {
+                entry.evaluator = endgame::kbnk;
+                entry.strong_side = strong;
+            } else if (strong_npm >= material[r] && entry.scale[strong] != SCALE_DRAW) {
+                entry.evaluator = endgame::kxk;
+                entry.strong_side = strong;
+            }
+        }
+
+        // Rook against pawn.
+        if (strong_npm == material[r] && counts[us + r] == 1 && counts[us + p] == 0
+            && weak_npm == 0 && counts[them + p] == 1) {
+            entry.evaluator = endgame::krkp;
+            entry.strong_side = strong;
+        }
+
+        // Bishop and pawns, the wrong rook pawn is checked per position.
+        if (strong_npm == material[b] && counts[us + p] > 0 && weak_npm == 0)
+            entry.scale_funcs[strong] = endgame::kbpsk;
+    }
+
+    // Pure opposite coloured bishops are checked per position.
+    if (non_pawn_material(state, white) == material[b] && counts[B] == 1
+        && non_pawn_material(state, black) == material[b] && counts[b] == 1)
+        entry.scale_funcs = { endgame::opposite_bishops, endgame::opposite_bishops };
+}
+
+namespace endgame {
+
+    /// Mating material against a lone king, drives the king to the edge.
+    Score kxk(const BoardState& state, Colour strong) {
+        Square strong_king = king_sq(state, strong);
+        Square weak_king = king_sq(state, strong ^ 1);
+        Piece us = strong == white ? P : p;
+
+        Score score = non_pawn_material(state, strong) + material[p] * pop_count(state.bitboards[us + p]);
+        score = std::min(score, Score(2000));
+        score += push_to_edge(weak_king) + push_close(strong_king, weak_king);
+
+        BB bishops = state.bitboards[us + b];
+        if (state.bitboards[us + q] || state.bitboards[us + r]
+            || (state.bitboards[us + n] && bishops)
+            || ((bishops & DARK_SQUARES) && (bishops & ~DARK_SQUARES)))
+            score += KNOWN_WIN;
+
+        return score;
+    }
+
+    /// Bishop and knight mate, drives the king to a corner of the bishop's colour.
+    Score kbnk(const BoardState& state, Colour strong) {
+        Square strong_king = king_sq(state, strong);
+        Square weak_king = king_sq(state, strong ^ 1);
+        Square bishop = bitscan_forward(state.bitboards[strong == white ? B : b]);
+
+        int corner_dist = is_dark(bishop)
+            ? std::min(distance(weak_king, a1), distance(weak_king, h8))
+            : std::min(distance(weak_king, h1), distance(weak_king, a8));
+
+        return KNOWN_WIN + material[n] + material[b] + push_close(strong_king, weak_king) + 40 * (7 - corner_dist);
+    }
+
+    /// King and pawn against king, exact from the bitbase, wins push the pawn forward.
+    Score kpk(const BoardState& state, Colour strong) {
+        Square pawn = bitscan_forward(state.bitboards[strong == white ? P : p]);
+        if (!bitbase::probe_kpk(king_sq(state, strong), pawn, king_sq(state, strong ^ 1), strong, state.side_to_move))
+            return 0;
+
+        return KNOWN_WIN + material[p] + 10 * get_rank(relative_sq(pawn, strong));
+    }
+
+    /// Rook against pawn. See https://www.chessprogramming.org/Rook_versus_Pawn_Endgame.
+    Score krkp(const BoardState& state, Colour strong) {
+        // Squares are seen from the weak side, its pawn promotes on the 8th rank.
+        Colour weak = strong ^ 1;
+        Square strong_king = relative_sq(king_sq(state, strong), weak);
+        Square weak_king = relative_sq(king_sq(state, weak), weak);
+        Square rook = relative_sq(bitscan_forward(state.bitboards[strong == white ? R : r]), weak);
+        Square pawn = relative_sq(bitscan_forward(state.bitboards[weak == white ? P : p]), weak);
+        Square promo_sq = get_file(pawn) + 56;
+        Square push_sq = pawn + 8;
+        bool weak_to_move = state.side_to_move == weak;
+
+        // The strong king is in front of the pawn.
+        if (get_file(strong_king) == get_file(pawn) && get_rank(strong_king) > get_rank(pawn))
+            return material[r] - distance(strong_king, pawn);
+
+        // The weak king is too far from both the pawn and the rook.
+        if (distance(weak_king, pawn) >= 3 + (weak_to_move ? 1 : 0) && distance(weak_king, rook) >= 3)
+            return material[r] - distance(strong_king, pawn);
+
+        // An advanced pawn supported by its king, with the strong king far away.
+        if (get_rank(weak_king) >= 5 && distance(weak_king, pawn) == 1
+            && get_rank(strong_king) <= 4 && distance(strong_king, pawn) > 2 + (weak_to_move ? 0 : 1))
+            return 80 - 8 * distance(strong_king, pawn);
+
+        return 200 - 8 * (distance(strong_king, push_sq) - distance(weak_king, push_sq) - distance(pawn, promo_sq));
+    }
+
+    /// Bishop and rook pawns of one file, a draw when the bishop misses the promotion square and the defending king holds it.
+    int kbpsk(const BoardState& state, Colour strong) {
+        BB pawns = state.bitboards[strong == white ? P : p];
+        if ((pawns & ~AFILE) && (pawns & ~HFILE)) return SCALE_NONE;
+
+        Square promo_sq = (pawns & AFILE ? 0 : 7) + (strong == white ? 56 : 0);
+        Square bishop = bitscan_forward(state.bitboards[strong == white ? B : b]);
+        Square weak_king = king_sq(state, strong ^ 1);
+
+        if (is_dark(bishop) != is_dark(promo_sq) && distance(weak_king, promo_sq) <= 1)
+            return SCALE_DRAW;
+
+        return SCALE_NONE;
+    }
+
+    /// Opposite coloured bishops without other pieces are drawish.
+    int opposite_bishops(const BoardState& state, Colour strong) {
+        if (is_dark(bitscan_forward(state.bitboards[B])) == is_dark(bitscan_forward(state.bitboards[b])))
+            return SCALE_NONE;
+
+        Piece us = strong == white ? P : p;
+        Piece them = strong == white ? p : P;
+        int pawn_diff = pop_count(state.bitboards[us + p]) - pop_count(state.bitboards[them + p]);
+        return pawn_diff <= 1 ? SCALE_NORMAL / 4 : SCALE_NORMAL / 2;
+    }
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "../include/nnue.hpp"
+#include "../include/board.hpp"
+#include "../include/material.hpp"
+
+using namespace bb_math;
+using namespace nnue;
+
+namespace {
+    constexpr std::array<char, 4> MAGIC = { 'C', 'N', 'N', '1' };
+    constexpr int INPUT_DIMS = 2 * HALF_DIMS;
+    constexpr int MAX_CHANGES = 32; // Features added or removed by one update, a move changes at most 4.
+
+    struct Network {
+        std::vector<int16_t> ft_biases, ft_weights;
+        std::vector<int32_t> l1_biases, l2_biases, out_biases;
+        std::vector<int8_t> l1_weights, l2_weights, out_weights;
+    };
+
+    Network net;
+    bool loaded = false;
+
+    /// Piece kinds are ordered p, n, b, r, q, with the perspective's own pieces first.
+    inline int feature(Colour perspective, Square king_sq, Piece piece, Square sq) {
+        Square orient = perspective == white ? 0 : 56;
+        int kind = 2 * (piece % 6) + ((piece >= P ? white : black) != perspective);
+        return (king_sq ^ orient) * 641 + 1 + kind * 64 + (sq ^ orient);
+    }
+
+#if defined(__AVX2__)
+    using vec_t = __m256i;
+    inline vec_t vec_zero() { return _mm256_setzero_si256(); }
+    inline vec_t vec_load(const void* ptr) { return _mm256_loadu_si256(static_cast<const vec_t*>(ptr)); }
+    inline void vec_store(void* ptr, vec_t v) { _mm256_storeu_si256(static_cast<vec_t*>(ptr), v); }
+    inline vec_t vec_add_16(vec_t a, vec_t b) { return _mm256_add_epi16(a, b); }
+    inline vec_t vec_sub_16(vec_t a, vec_t b) { return _mm256_sub_epi16(a, b); }
+
+    /// Sums the products of 32 uint8 inputs and int8 weights into 8 int32 lanes of sum.
+    inline vec_t vec_dot_add(vec_t sum, vec_t in, vec_t w) {
+        vec_t products = _mm256_maddubs_epi16(in, w);
+        return _mm256_add_epi32(sum, _mm256_madd_epi16(products, _mm256_set1_epi16(1)));
+    }
+
+    inline int vec_hsum(vec_t v) {
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+        return _mm_cvtsi128_si32(sum);
+    }
+#define NNUE_SIMD
+#elif defined(__SSE4_1__)
+    using vec_t = __m128i;
+    inline vec_t vec_zero() { return _mm_setzero_si128(); }
+    inline vec_t vec_load(const void* ptr) { return _mm_loadu_si128(static_cast<const vec_t*>(ptr)); }
+    inline void vec_store(void* ptr, vec_t v) { _mm_storeu_si128(static_cast<vec_t*>(ptr), v); }
+    inline vec_t vec_add_16(vec_t a, vec_t b) { return _mm_add_epi16(a, b); }
+    inline vec_t vec_sub_16(vec_t a, vec_t b) { return _mm_sub_epi16(a, b); }
+
+    inline vec_t vec_dot_add(vec_t sum, vec_t in, vec_t w) {
+        vec_t products = _mm_maddubs_epi16(in, w);
+        return _mm_add_epi32(sum, _mm_madd_epi16(products, _mm_set1_epi16(1)));
+    }
+
+    inline int vec_hsum(vec_t v) {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+        return _mm_cvtsi128_si32(v);
+    }
+#define NNUE_SIMD
+#endif
+
+    /// dst = src + the first layer rows of added - the rows of removed.
+    void apply_rows(int16_t* dst, const int16_t* src, std::span<const int> added, std::span<const int> removed) {
+#ifdef NNUE_SIMD
+        // Columns are summed in tiles of registers, each row is loaded once per tile.
+        constexpr int REGS = 8;
+        constexpr int LANES = sizeof(vec_t) / sizeof(int16_t);
+        constexpr int TILE = REGS * LANES;
+        static_assert(HALF_DIMS % TILE == 0);
+
+        for (int tile = 0; tile < HALF_DIMS; tile += TILE) {
+            vec_t regs[REGS];
+            for (int i = 0; i < REGS; ++i) regs[i] = vec_load(src + tile + i * LANES);
+
+            for (int f : added) {
+                const int16_t* row = &net.ft_weights[f * HALF_DIMS + tile];
+                for (int i = 0; i < REGS; ++i) regs[i] = vec_add_16(regs[i], vec_load(row + i * LANES));
+            }
+
+            for (int f : removed) {
+                const int16_t* row = &net.ft_weights[f * HALF_DIMS + tile];
+                for (int i = 0; i < REGS; ++i) regs[i] = vec_sub_16(regs[i], vec_load(row + i * LANES));
+            }
+
+            for (int i = 0; i < REGS; ++i) vec_store(dst + tile + i * LANES, regs[i]);
+        }
+#else
+        std::copy(src, src + HALF_DIMS, dst);
+        for (int f : added)
+            for (int i = 0; i < HALF_DIMS; ++i) dst[i] += net.ft_weights[f * HALF_DIMS + i];
+        for (int f : removed)
+            for (int i = 0; i < HALF_DIMS; ++i) dst[i] -= net.ft_weights[f * HALF_DIMS + i];
+#endif
+    }
+
+    /// out = biases + weights * in, with weights stored [OUT][IN].
+    template <int IN, int OUT>
+    void affine(const uint8_t* in, const int8_t* weights, const int32_t* biases, int32_t* out) {
+#ifdef NNUE_SIMD
+        constexpr int LANES = sizeof(vec_t);
+        static_assert(IN % LANES == 0);
+
+        for (int o = 0; o < OUT; ++o) {
+            vec_t sum = vec_zero();
+            for (int i = 0; i < IN; i += LANES)
+                sum = vec_dot_add(sum, vec_load(in + i), vec_load(weights + o * IN + i));
+            out[o] = biases[o] + vec_hsum(sum);
+        }
+#else
+        for (int o = 0; o < OUT; ++o) {
+            int32_t sum = biases[o];
+            for (int i = 0; i < IN; ++i) sum += in[i] * weights[o * IN + i];
+            out[o] = sum;
+        }
+#endif
+    }
+
+    template <int N>
+    void clipped_relu(const int32_t* in, uint8_t* out) {
+        for (int i = 0; i < N; ++i) out[i] = std::clamp(in[i] >> WEIGHT_SHIFT, 0, 127);
+    }
+
+    template <typename T>
+    bool read_array(std::ifstream& file, std::vector<T>& values, size_t size) {
+        values.resize(size);
+        return bool(file.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+    }
+}
+
+bool nnue::load(const std::filesystem::path& path) {
+    net = {};
+    loaded = false;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::array<char, 4> magic;
+    std::array<uint32_t, 3> dims;
+    file.read(magic.data(), magic.size());
+    file.read(reinterpret_cast<char*>(dims.data()), sizeof(dims));
+    if (!file || magic != MAGIC || dims != std::array<uint32_t, 3>{ HALF_DIMS, L1_DIMS, L2_DIMS }) return false;
+
+    Network loading;
+    bool ok = read_array(file, loading.ft_biases, HALF_DIMS)
+        && read_array(file, loading.ft_weights, size_t(FEATURES) * HALF_DIMS)
+        && read_array(file, loading.l1_biases, L1_DIMS)
+        && read_array(file, loading.l1_weights, L1_DIMS * INPUT_DIMS)
+        && read_array(file, loading.l2_biases, L2_DIMS)
+        && read_array(file, loading.l2_weights, L2_DIMS * L1_DIMS)
+        && read_array(file, loading.out_biases, 1)
+        && read_array(file, loading.out_weights, L2_DIMS);
+
+    // Trailing data means a different architecture.
+    if (!ok || file.peek() != std::ifstream::traits_type::eof()) return false;
+
+    net = std::move(loading);
+    loaded = true;
+    return true;
+}
+
+bool nnue::is_loaded() { return loaded; }
+
+void nnue::refresh(Accumulator& acc, const BoardState& state, Colour perspective) {
+    std::array<int, MAX_CHANGES> added;
+    int num_added = 0;
+    Square king_sq = bitscan_forward(state.bitboards[perspective == white ? K : k]);
+
+    for (Piece piece : { p, n, b, r, q, P, N, B, R, Q }) {
+        BB pieces = state.bitboards[piece];
+        while (pieces) added[num_added++] = feature(perspective, king_sq, piece, pop_lsb(pieces));
+    }
+
+    apply_rows(acc.values[perspective].data(), net.ft_biases.data(), std::span(added.data(), num_added), {});
+    acc.computed[perspective] = true;
+}
+
+void nnue::update(Accumulator& acc, const Accumulator& parent, const BoardState& state,
+                  const BoardState& parent_state, Colour perspective) {
+    std::array<int, MAX_CHANGES> added, removed;
+    int num_added = 0, num_removed = 0;
+    Square king_sq = bitscan_forward(state.bitboards[perspective == white ? K : k]);
+
+    // Comparing the piece sets covers every move type, and null moves change nothing.
+    for (Piece piece : { p, n, b, r, q, P, N, B, R, Q }) {
+        BB changed = state.bitboards[piece] ^ parent_state.bitboards[piece];
+        BB gained = changed & state.bitboards[piece];
+        BB lost = changed & parent_state.bitboards[piece];
+        while (gained) added[num_added++] = feature(perspective, king_sq, piece, pop_lsb(gained));
+        while (lost) removed[num_removed++] = feature(perspective, king_sq, piece, pop_lsb(lost));
+    }
+
+    apply_rows(acc.values[perspective].data(), parent.values[perspective].data(),
+               std::span(added.data(), num_added), std::span(removed.data(), num_removed));
+    acc.computed[perspective] = true;
+}
+
+Score nnue::evaluate(const Accumulator& acc, Colour stm) {
+    alignas(64) std::array<uint8_t, INPUT_DIMS> input;
+    alignas(64) std::array<int32_t, L1_DIMS> l1_out;
+    alignas(64) std::array<uint8_t, L1_DIMS> l1_act;
+    alignas(64) std::array<int32_t, L2_DIMS> l2_out;
+    alignas(64) std::array<uint8_t, L2_DIMS> l2_act;
+    int32_t output;
+
+    // The side to move's half comes first.
+    for (int i = 0; i < HALF_DIMS; ++i) {
+        input[i] = std::clamp<int>(acc.values[stm][i], 0, 127);
+        input[HALF_DIMS + i] = std::clamp<int>(acc.values[stm ^ 1][i], 0, 127);
+    }
+
+    affine<INPUT_DIMS, L1_DIMS>(input.data(), net.l1_weights.data(), net.l1_biases.data(), l1_out.data());
+    clipped_relu<L1_DIMS>(l1_out.data(), l1_act.data());
+    affine<L1_DIMS, L2_DIMS>(l1_act.data(), net.l2_weights.data(), net.l2_biases.data(), l2_out.data());
+    clipped_relu<L2_DIMS>(l2_out.data(), l2_act.data());
+    affine<L2_DIMS, 1>(l2_act.data(), net.out_weights.data(), net.out_biases.data(), &output);
+
+    // Known wins and mates stay above anything the network returns.
+    return std::clamp(output / FV_SCALE, -KNOWN_WIN + 1, KNOWN_WIN - 1);
+}
@@ -0,0 +1,130 @@
+#ifdef ENGINE_TUNE
+
+#include <algorithm>
+#include <fstream>
+#include <print>
+#include <sstream>
+
+#include "../include/params.hpp"
+#include "../include/eval.hpp"
+#include "../include/eval_cache.hpp"
+#include "../include/material.hpp"
+#include "../include/pawn_hash.hpp"
+#include "../include/utils.hpp"
+
+namespace {
+    std::vector<params::Param> build_registry() {
+        std::vector<params::Param> list;
+
+#define REGISTER_PARAM(name, value, min, max) list.push_back({ #name, &name, min, max, false });
+        SEARCH_PARAMS(REGISTER_PARAM)
+#undef REGISTER_PARAM
+
+        auto add_term = [&](const std::string& name, PhaseScore& term) {
+            list.push_back({ name + "_mg", &term.mg, -500, 500, true });
+            list.push_back({ name + "_eg", &term.eg, -500, 500, true });
+        };
+        add_term("DBL_PAWNS_PEN", DBL_PAWNS_PEN);
+        add_term("TRI_PAWNS_PEN", TRI_PAWNS_PEN);
+        add_term("PASS_PAWNS_BONUS", PASS_PAWNS_BONUS);
+        add_term("ISO_PAWNS_PEN", ISO_PAWNS_PEN);
+        add_term("HALF_ISO_PAWNS_PEN", HALF_ISO_PAWNS_PEN);
+        add_term("OPEN_FILE_ROOKS_BONUS", OPEN_FILE_ROOKS_BONUS);
+        add_term("HALF_OPEN_FILE_ROOKS_BONUS", HALF_OPEN_FILE_ROOKS_BONUS);
+        add_term("KNIGHT_MOBILITY_BONUS", KNIGHT_MOBILITY_BONUS);
+        add_term("BISHOP_MOBILITY_BONUS", BISHOP_MOBILITY_BONUS);
+        add_term("ROOK_MOBILITY_BONUS", ROOK_MOBILITY_BONUS);
+        add_term("QUEEN_MOBILITY_BONUS", QUEEN_MOBILITY_BONUS);
+        add_term("KING_ZONE_ATTACK_BONUS", KING_ZONE_ATTACK_BONUS);
+        add_term("PAWN_THREAT_BONUS", PAWN_THREAT_BONUS);
+        add_term("MINOR_THREAT_BONUS", MINOR_THREAT_BONUS);
+        add_term("HANGING_PIECE_BONUS", HANGING_PIECE_BONUS);
+
+        constexpr std::array<const char*, 5> material_names = { "pawn", "knight", "bishop", "rook", "queen" };
+        for (Piece piece = p; piece <= q; ++piece)
+            list.push_back({ std::string("material_") + material_names[piece], &material[piece], 0, 3000, true });
+
+        // Entries are named by the square of a white piece, tables are laid out from a8 to h1.
+        auto add_table = [&](const std::string& name, std::array<Score, 64>& table) {
+            for (Square sq = 0; sq < 64; ++sq)
+                list.push_back({ name + "_" + square_to_string(flip_rank(sq)), &table[sq], -1000, 1000, true });
+        };
+        add_table("pawn_psqt_mg", pawn_psqt[0]);
+        add_table("pawn_psqt_eg", pawn_psqt[1]);
+        add_table("knight_psqt", knight_psqt);
+        add_table("bishop_psqt", bishop_psqt);
+        add_table("rook_psqt", rook_psqt);
+        add_table("queen_psqt", queen_psqt);
+        add_table("king_psqt_mg", king_psqt[0]);
+        add_table("king_psqt_eg", king_psqt[1]);
+
+        return list;
+    }
+
+    bool set_value(const std::string& name, int value, bool& eval_changed) {
+        const params::Param* param = params::find(name);
+        if (param == nullptr) return false;
+
+        *param->value = std::clamp(value, param->min, param->max);
+        eval_changed |= param->is_eval;
+        return true;
+    }
+}
+
+const std::vector<params::Param>& params::registry() {
+    static const std::vector<Param> list = build_registry();
+    return list;
+}
+
+const params::Param* params::find(const std::string& name) {
+    for (const Param& param : registry())
+        if (param.name == name) return &param;
+    return nullptr;
+}
+
+void params::rebuild_eval() {
+    psqt_values = make_psqt_values();
+    pawn_hash.clear();
+    material_table.clear();
+    eval_cache.clear();
+}
+
+bool params::set(const std::string& name, int value) {
+    bool eval_changed = false;
+    if (!set_value(name, value, eval_changed)) return false;
+    if (eval_changed) rebuild_eval();
+    return true;
+}
+
+int params::load(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file) return -1;
+
+    int count = 0;
+    bool eval_changed = false;
+    for (std::string line; std::getline(file, line);) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream iss(line);
+        std::string name;
+        int value;
+        if (!(iss >> name >> value)) continue;
+
+        if (set_value(name, value, eval_changed)) count++;
+        else std::println("info string unknown parameter {}", name);
+    }
+
+    if (eval_changed) rebuild_eval();
+    return count;
+}
+
+void params::print_options() {
+    for (const Param& param : registry())
+        std::println("option name {} type spin default {} min {} max {}", param.name, *param.value, param.min, param.max);
+}
+
+void params::print() {
+    for (const Param& param : registry())
+        std::println("{} {}", param.name, *param.value);
+}
+
+#endif
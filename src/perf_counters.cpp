@@ -0,0 +1,89 @@
+#include "../include/perf_counters.hpp"
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint64_t cache_miss(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    struct EventConfig {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    constexpr std::array<EventConfig, PerfCounters::NUM_EVENTS> configs = {{
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D) },
+        { PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    }};
+
+    /// Opens a disabled counter of the calling thread, user space only so it works
+    /// with the default perf_event_paranoid setting. Returns -1 if refused.
+    int open_event(const EventConfig& event) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = event.type;
+        attr.config = event.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+}
+
+PerfCounters::PerfCounters() {
+    for (int event = 0; event < NUM_EVENTS; ++event)
+        fds[event] = open_event(configs[event]);
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds)
+        if (fd >= 0) close(fd);
+}
+
+void PerfCounters::start() {
+    for (int fd : fds)
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void PerfCounters::stop() {
+    for (int event = 0; event < NUM_EVENTS; ++event) {
+        if (fds[event] < 0) continue;
+        ioctl(fds[event], PERF_EVENT_IOC_DISABLE, 0);
+
+        // Value, time enabled and time running. A counter that never ran is unavailable.
+        uint64_t data[3];
+        if (read(fds[event], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            close(fds[event]);
+            fds[event] = -1;
+            continue;
+        }
+
+        values[event] = data[2] < data[1]
+            ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters() { fds.fill(-1); }
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+
+#endif
+
+bool PerfCounters::is_any_available() const {
+    for (int fd : fds)
+        if (fd >= 0) return true;
+    return false;
+}
@@ -0,0 +1,32 @@
+#ifdef ENGINE_PROFILE
+
+#include <print>
+
+#include "../include/profiler.hpp"
+
+namespace {
+    constexpr std::array<const char*, profiler::NUM_SECTIONS> section_names = {
+        "generate_moves", "make_move", "unmake_last_move", "eval", "see", "order_moves", "probe", "store_entry"
+    };
+
+    thread_local uint64_t start_cycles = 0;
+}
+
+void profiler::reset() {
+    counters.fill(Counter{});
+    start_cycles = __rdtsc();
+}
+
+void profiler::report() {
+    uint64_t total = __rdtsc() - start_cycles;
+    std::println("info string profile total cycles {}", total);
+
+    for (int section = 0; section < NUM_SECTIONS; ++section) {
+        const Counter& counter = counters[section];
+        std::println("info string profile {} calls {} cycles/call {:.1f} share {:.1f}%", section_names[section],
+            counter.calls, counter.calls ? static_cast<double>(counter.cycles) / counter.calls : 0.0,
+            total ? 100.0 * counter.cycles / total : 0.0);
+    }
+}
+
+#endif
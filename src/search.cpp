@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <print>
 #include <random>
 #include <cstdio>
@@ -7,6 +8,9 @@
 #include "../include/utils.hpp"
 #include "../include/transposition.hpp"
 #include "../include/book.hpp"
+#include "../include/eval_cache.hpp"
+#include "../include/tablebase.hpp"
+#include "../include/profiler.hpp"
 
 /// @brief Values for scoring captures. See https://www.chessprogramming.org/MVV-LVA.
 constexpr std::array<std::array<int, 6>, 5> MVV_LVA_table = {{
@@ -55,6 +59,7 @@ bool Board::is_search_stopped(int ply) {
 }
 
 void Board::order_moves(Move hash_move, int ply) {
+    PROFILE_SCOPE(ORDER_MOVES);
     MoveList& list = state.move_list;
     const int pv_index = get_pv_index(ply);
 
@@ -115,10 +120,13 @@ void Board::order_moves(Move hash_move, int ply) {
 
 // See https://www.chessprogramming.org/Quiescence_Search.
 Score Board::quiescence(Score alpha, Score beta, int ply) {
+    nodes++;
+    SEARCH_STAT(search_stats.qnodes++);
+    seldepth = std::max(seldepth, ply);
 
     Score best_val = alpha;
     bool check_flag = true;
-    Score stand_pat = eval();
+    Score stand_pat = probe_eval();
     best_val = stand_pat;
     generate_moves<CAPTURES>(); 
 
@@ -131,8 +139,8 @@ Score Board::quiescence(Score alpha, Score beta, int ply) {
     
     for (Move move : state.move_list) {
         // Delta Pruning.
-        int delta = 975;
-        if (get_code(move) >= c_npromo) delta += 775;
+        int delta = DELTA_MARGIN;
+        if (get_code(move) >= c_npromo) delta += DELTA_PROMO_MARGIN;
         if (stand_pat < alpha - delta) return alpha;
 
         // See pruning
@@ -144,7 +152,6 @@ Score Board::quiescence(Score alpha, Score beta, int ply) {
             continue;
 
         make_move(move);
-        nodes++;
 
         Score score = -quiescence(-beta, -alpha, ply + 1);
 
@@ -165,6 +172,7 @@ Score Board::search_root(int depth, Score alpha, Score beta) {
     int moves_searched = 0;
     EntryType ent = UPPER;
     Score old_alpha = alpha;
+    nodes++;
     
     generate_moves<ALLMOVES>();
     order_moves(nullmove, 0);
@@ -199,7 +207,7 @@ Score Board::search_root(int depth, Score alpha, Score beta) {
                 history_moves[from][to][state.side_to_move] = depth * depth;
             }
 
-            TranspositionEntry new_entry;
+            TranspositionEntry new_entry{};
             new_entry.depth = depth;
             new_entry.hash_move = move;
             new_entry.key = state.hash_key;
@@ -228,7 +236,7 @@ Score Board::search_root(int depth, Score alpha, Score beta) {
     else
         ent = EXACT;
 
-    TranspositionEntry new_entry;
+    TranspositionEntry new_entry{};
     new_entry.depth = depth;
     new_entry.hash_move = pv_table[0];
     new_entry.key = state.hash_key;
@@ -249,15 +257,39 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
     if (depth <= 0)
         return quiescence(alpha, beta, ply);
 
+    nodes++;
+    seldepth = std::max(seldepth, ply);
+
     int pv_idx = get_pv_index(ply);
     int next_pv_idx = get_next_pv_index(ply);
 
-    // Handle upcoming repetitions.
-    if (is_rep())
+    // Handle repetitions and material that cannot mate.
+    if (is_rep(ply) || is_known_draw())
         return 0;
 
-    // Transposition Table Cut-offs
-    TranspositionEntry *entry = game_table->probe(state.hash_key, depth);
+    // Tablebase positions are exact.
+    if (ply > 0 && bb_math::pop_count(state.bitboards[allpieces]) <= tablebase::max_pieces) {
+        if (uint8_t value; tablebase::probe(state, value))
+            return tablebase::value_to_score(value, ply);
+    }
+
+    // Exact bitbase results, a win is a bound beyond any material balance.
+    if (Score bitbase_score; ply > 0 && probe_bitbase(bitbase_score)) {
+        if (bitbase_score == 0) return 0;
+        if (bitbase_score > 0 ? bitbase_score >= beta : bitbase_score <= alpha) return bitbase_score;
+    }
+
+    // A reversible move reaches an earlier position, so a draw is at least available.
+    if (alpha < 0 && is_upcoming_rep(ply)) {
+        alpha = 0;
+        if (alpha >= beta) return alpha;
+    }
+
+    // Transposition Table Cut-offs, shallower entries still provide the static eval.
+    TranspositionEntry *tt_entry = game_table->probe(state.hash_key);
+    TranspositionEntry *entry = (tt_entry != nullptr && tt_entry->depth >= depth) ? tt_entry : nullptr;
+    SEARCH_STAT(search_stats.tt_probes++);
+    SEARCH_STAT(search_stats.tt_hits += tt_entry != nullptr);
 
     // Ensures that pv is not shortened
     if (entry != nullptr && pv_table[pv_idx] != nullmove) {
@@ -269,10 +301,14 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
         if (!is_pv_node) {
             if (ent == EXACT ||
             (ent == LOWER && ents >= beta) ||
-            (ent == UPPER && ents < alpha))
+            (ent == UPPER && ents < alpha)) {
+                SEARCH_STAT(search_stats.tt_cutoffs++);
                 return ents;
-        } else if (ent == EXACT)
+            }
+        } else if (ent == EXACT) {
+            SEARCH_STAT(search_stats.tt_cutoffs++);
             return ents;
+        }
     }
 
     generate_moves<ALLMOVES>();
@@ -289,7 +325,8 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
     pv_table[pv_idx] = nullmove;
     pv_length[ply] = 0;
     Score old_alpha = alpha;
-    Score static_eval = eval();
+    Score static_eval = (tt_entry != nullptr && tt_entry->static_eval != NO_EVAL) ? tt_entry->static_eval : probe_eval();
+    assert(static_eval == eval());
 
     // Null Move Pruning
     bool only_king_and_pawns = 
@@ -300,41 +337,39 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
     && (static_eval >= beta);
 
     if (do_null_pruning) {
-        int R = depth > 6 ? 4 : 3;
+        int R = depth > NMP_DEEP_DEPTH ? NMP_DEEP_REDUCTION : NMP_REDUCTION;
         make_null_move();
         score = -search(depth - R, ply + 1, -beta, -beta + 1, false, false);
         unmake_last_move();
+        SEARCH_STAT(search_stats.null_moves++);
+        SEARCH_STAT(search_stats.null_move_cutoffs += score >= beta);
         if (score >= beta) return score;
     }
 
     bool f_prune = 
     (depth < 3) && !state.is_in_check && !is_pv_node && (abs(alpha) < MATE_VALUE);
     for (Move move : state.move_list) {
-        make_move(move);
-        
+        // Pruning is decided before the move is made, moves giving check are never pruned.
+        bool prune_candidate = f_prune && is_move(move, capture) && (get_code(move) < npromo) && !gives_check(move);
+
         // Futility Pruning
-        if (f_prune && !is_side_in_check(state.side_to_move) 
-        && is_move(move, capture) && (get_code(move) < npromo)
-        && (static_eval + (FUTILITY_MARGIN * depth * depth) <= alpha)) {
-            unmake_last_move();
+        if (prune_candidate && (static_eval + (FUTILITY_MARGIN * depth * depth) <= alpha))
             continue;
-        }
 
         // Late Move Pruning
-        if (f_prune && !is_side_in_check(state.side_to_move) 
-        && is_move(move, capture) && (get_code(move) < npromo)
-        && moves_searched > 5) {
-            unmake_last_move();
+        if (prune_candidate && moves_searched > LMP_MOVES)
             continue;
-        }
+
+        make_move(move);
 
         // Late Move Reductions
         int reduction = 0;
-        if (!is_pv_node && new_depth > 3 && moves_searched > 3
+        if (!is_pv_node && new_depth > LMR_MIN_DEPTH && moves_searched > LMR_MIN_MOVES
             && !is_move(move, capture) && get_code(move) < npromo && !state.is_in_check) {
-            if (moves_searched < 6) reduction += 3;
-            if (moves_searched > 8) reduction += 4;
+            if (moves_searched < LMR_EARLY_MOVES) reduction += LMR_EARLY_REDUCTION;
+            if (moves_searched > LMR_LATE_MOVES) reduction += LMR_LATE_REDUCTION;
             new_depth -= reduction;
+            SEARCH_STAT(search_stats.reductions += reduction > 0);
         }
 
         if (!raised_alpha)
@@ -349,6 +384,7 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
 
         // Research LMR
         if (reduction && score > alpha) {
+            SEARCH_STAT(search_stats.lmr_researches++);
             new_depth += reduction;
             reduction = 0;
 
@@ -363,12 +399,13 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
             }
         }
         
-        nodes++;
         moves_searched++;
 
         unmake_last_move();
 
         if (score >= beta) {
+            SEARCH_STAT(search_stats.fail_highs++);
+            SEARCH_STAT(search_stats.first_move_fail_highs += moves_searched == 1);
             if (!is_move_capture(move)) {
                 // Update killer heuristics. See https://www.chessprogramming.org/Killer_Heuristic.
                 if (killer_moves[ply][1] == nullmove) {
@@ -383,11 +420,12 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
                 history_moves[from][to][state.side_to_move] = depth * depth;
             }
             
-            TranspositionEntry new_entry;
+            TranspositionEntry new_entry{};
             new_entry.depth = depth;
             new_entry.hash_move = move;
             new_entry.key = state.hash_key;
             new_entry.score = beta;
+            new_entry.static_eval = static_eval;
             new_entry.type = LOWER;
             game_table->store_entry(new_entry);
             return beta;
@@ -407,7 +445,7 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
 
     if (state.move_list.is_empty()) {
         if (state.is_in_check) alpha = -MATE_VALUE + ply;
-        else alpha = -eval() / 3;
+        else alpha = -static_eval / 3;
     }
 
     if (alpha <= old_alpha)
@@ -417,11 +455,12 @@ Score Board::search(int depth, int ply, Score alpha, Score beta, bool is_pv_node
     else
         tt_type = EXACT;
 
-    TranspositionEntry new_entry;
+    TranspositionEntry new_entry{};
     new_entry.depth = depth;
     new_entry.hash_move = best_move;
     new_entry.key = state.hash_key;
     new_entry.score = score_to_tt(alpha, ply);
+    new_entry.static_eval = static_eval;
     new_entry.type = tt_type;
     game_table->store_entry(new_entry);
 
@@ -449,12 +488,39 @@ int choose_weighted_book_move(const std::vector<polyglot::BookEntry>& entries) {
     return 0;
 }
 
+/// Prints a UCI score, mates in moves.
+static void print_score(Score score) {
+    if (abs(score) < MATE_VALUE - 100)
+        std::print(" score cp {}", score);
+    else {
+        // Mate is printed in moves not plies, hence halving and +/- 1.
+        int moves_to_mate = (score > 0) ? (MATE_VALUE - score + 1) / 2 : -(MATE_VALUE + score + 1) / 2;
+        std::print(" score mate {}", moves_to_mate);
+    }
+}
+
+#ifdef ENGINE_STATS
+/// Percentage helper for the statistics, 0 without any events.
+static double percent(long part, long whole) { return whole ? 100.0 * part / whole : 0.0; }
+
+/// Prints the statistics of an iteration, the branching factor is relative to the previous iteration.
+static void print_stats(long prev_nodes) {
+    const SearchStats& s = search_stats;
+    std::println("info string stats ebf {:.2f} tt hits {:.1f}% cutoffs {:.1f}% first move fail highs {:.1f}% "
+                 "null move cutoffs {:.1f}% lmr researches {:.1f}% qnodes {:.1f}%",
+        prev_nodes ? static_cast<double>(nodes) / prev_nodes : 0.0,
+        percent(s.tt_hits, s.tt_probes), percent(s.tt_cutoffs, s.tt_probes),
+        percent(s.first_move_fail_highs, s.fail_highs), percent(s.null_move_cutoffs, s.null_moves),
+        percent(s.lmr_researches, s.reductions), percent(s.qnodes, nodes));
+}
+#endif
+
 void Board::run_search() {
     prev_state_idx = 0;  // Reset before search
     prev_states[prev_state_idx] = state;
 
     // First try the opening book
-    std::vector<polyglot::BookEntry> entries = polyglot::probe_book(polyglot::gen_poly_key(game_board.state));
+    std::vector<polyglot::BookEntry> entries = polyglot::probe_book(polyglot::gen_poly_key(state));
 
     if (!entries.empty()) {
         #ifdef TOPBOOK
@@ -463,7 +529,17 @@ void Board::run_search() {
             int idx = choose_weighted_book_move(entries); // weighted random
         #endif
         polyglot::BookEntry chosen = entries[idx];
-        std::println("info string book move\nbestmove {}", move_to_string(polyglot::get_book_move(chosen, game_board.state)));
+        std::println("info string book move\nbestmove {}", move_to_string(polyglot::get_book_move(chosen, state)));
+        std::fflush(stdout);
+        return;
+    }
+
+    // Then the tablebases, which know the result of every move.
+    Score tb_score;
+    if (Move tb_move = tablebase::probe_root(*this, tb_score); tb_move != nullmove) {
+        std::print("info string tablebase move\ninfo depth 1");
+        print_score(tb_score);
+        std::println(" pv {}\nbestmove {}", move_to_string(tb_move), move_to_string(tb_move));
         std::fflush(stdout);
         return;
     }
@@ -487,6 +563,10 @@ void Board::run_search() {
     pv_length.fill(0);
     Score alpha = -INF, beta = INF;
     start_time = std::chrono::steady_clock::now();
+    game_table->new_search();
+    total_nodes = 0;
+    pawn_hash.reset_stats();
+    eval_cache.reset_stats();
     int d = 1;
 
     // Decay history heuristic.
@@ -498,28 +578,32 @@ void Board::run_search() {
     bool aw_research = false;
     int fail_lows = 0;
     int fail_highs = 0;
+    [[maybe_unused]] long prev_nodes = 0;
     while (1) {
         nodes = 0;
+        seldepth = 0;
+        SEARCH_STAT(search_stats = SearchStats());
 
         if (d > 1 && !aw_research) {
             // Aspiration Windows
-            alpha = score - 25;
-            beta = score + 25;
+            alpha = score - ASPIRATION_WINDOW;
+            beta = score + ASPIRATION_WINDOW;
         }
 
         score = search_root(d, alpha, beta);
+        total_nodes += nodes;
 
         // Research Aspiration Windows with gradual widening.
         aw_research = false;
         if (score <= alpha) {
             fail_lows++;
-            alpha = score - (50 * fail_lows);
+            alpha = score - (ASPIRATION_WIDEN * fail_lows);
             aw_research = true;
         }
 
         if (score >= beta) {
             fail_highs++;
-            beta = beta + (50 * fail_highs);
+            beta = beta + (ASPIRATION_WIDEN * fail_highs);
             aw_research = true;
         }
 
@@ -530,21 +614,18 @@ void Board::run_search() {
         fail_highs = 0;
         fail_lows = 0;
         
-        std::print("info depth {} nodes {} time {}", d, nodes, elapsed_ms(depth_search_time)); 
+        int elapsed = elapsed_ms(depth_search_time);
+        std::print("info depth {} seldepth {} nodes {} nps {} time {} hashfull {}", d, seldepth, nodes,
+            nodes * 1000 / std::max(elapsed, 1), elapsed, game_table->hashfull());
         
-        if (abs(score) < MATE_VALUE - 100)
-            std::print(" score cp {}", score);
-        else {
-            // Mate is printed in moves not plies, hence halving and +/- 1.
-            int moves_to_mate = (score > 0) ? (MATE_VALUE - score + 1) / 2 : -(MATE_VALUE + score + 1) / 2;
-            std::print(" score mate {}", moves_to_mate);
-        }
-
+        print_score(score);
         std::print(" pv ");
         for (int i = 0; i < pv_length[0]; ++i)
             std::print("{} ", move_to_string(pv_table[i]));
 
         std::println();
+        SEARCH_STAT(print_stats(prev_nodes));
+        SEARCH_STAT(prev_nodes = nodes);
         std::fflush(stdout);
         
         depth_search_time = std::chrono::steady_clock::now();
@@ -556,6 +637,10 @@ void Board::run_search() {
     }
 
     stop_flag.store(true);
+    std::println("info string pawn hash hits {} probes {} rate {:.1f}%", pawn_hash.hits, pawn_hash.probes,
+        pawn_hash.probes ? 100.0 * pawn_hash.hits / pawn_hash.probes : 0.0);
+    std::println("info string eval cache hits {} probes {} rate {:.1f}%", eval_cache.hits, eval_cache.probes,
+        eval_cache.probes ? 100.0 * eval_cache.hits / eval_cache.probes : 0.0);
     std::println("bestmove {}", move_to_string(prev_pv_table[0] == nullmove ? fallback : prev_pv_table[0]));
     std::fflush(stdout);
 }
\ No newline at end of file
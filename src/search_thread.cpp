@@ -0,0 +1,44 @@
+#include "../include/search_thread.hpp"
+
+SearchThread::SearchThread() : thread([this]() { loop(); }) {}
+
+SearchThread::~SearchThread() {
+    {
+        std::lock_guard lock(mutex);
+        quit = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void SearchThread::post(std::function<void()> task) {
+    {
+        std::lock_guard lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    cv.notify_all();
+}
+
+void SearchThread::wait() {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [this]() { return tasks.empty() && !is_busy; });
+}
+
+void SearchThread::loop() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        cv.wait(lock, [this]() { return quit || !tasks.empty(); });
+        if (tasks.empty()) return;
+
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        is_busy = true;
+        lock.unlock();
+
+        task();
+
+        lock.lock();
+        is_busy = false;
+        cv.notify_all();
+    }
+}
@@ -0,0 +1,980 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <print>
+#include <queue>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../include/tablebase.hpp"
+#include "../include/board.hpp"
+#include "../include/search.hpp"
+
+using namespace bb_math;
+using namespace move_generator;
+
+namespace {
+    constexpr std::array<char, 4> MAGIC = { 'C', 'T', 'B', '3' };
+    constexpr uint32_t BLOCK_SIZE = 512; // Positions per compressed block.
+    constexpr int RUN_CLASSES = std::bit_width(BLOCK_SIZE) + 1; // A run of length l is in class bit_width(l).
+    constexpr int MAX_CODE_LENGTH = 24; // Longest Huffman code, within the 32 bits a decoder peeks at.
+    constexpr uint32_t GROUP_SIZE = 16; // Blocks sharing a 64 bit offset, the offset of a block in its group takes 16 bits.
+    static_assert(GROUP_SIZE * BLOCK_SIZE * 2 * MAX_CODE_LENGTH / 8 < 1 << 16, "a group of blocks can exceed 16 bit offsets");
+    constexpr int PEEK_BITS = 8; // Codes up to this long are decoded with one lookup.
+    constexpr std::string_view PIECE_CHARS = "PNBRQK"; // Indexed by piece type.
+    constexpr std::array<Piece, 5> SIGNATURE_ORDER = { q, r, b, n, p }; // Order of pieces in names and indices.
+
+    /// File layout: header, the code lengths of the values after each value (symbols x symbols bytes) and of the run
+    /// classes of each value (symbols x RUN_CLASSES bytes) padded to 8 bytes, the offset of each group of blocks into the data,
+    /// the 16 bit offset of each block into its group (padded to 8 bytes), then the blocks.
+    /// A block is a series of runs of a value: the value Huffman coded with the code of the value of the run before, the first
+    /// run of a block with the code of a draw, then the class of the run length with the code of the value, then the bits of
+    /// the length below its leading one. 8 bytes of padding follow the data for the decoder's reads.
+    struct FileHeader {
+        std::array<char, 4> magic;
+        uint32_t blocks;
+        uint64_t size; // Positions.
+        uint32_t max_dtm;
+        uint32_t symbols; // Stored values are below symbols.
+        std::array<char, 16> name;
+    };
+
+    /// Reads a bit stream most significant bit first, 32 bits at a time.
+    class BitReader {
+    private:
+        const uint8_t* next;
+        uint64_t buffer = 0; // Unread bits, left aligned.
+        int count = 0;
+    public:
+        BitReader(const uint8_t* data) : next(data) {}
+
+        /// The next 32 bits.
+        uint32_t peek() {
+            if (count < 32) {
+                uint32_t word;
+                std::memcpy(&word, next, sizeof(word));
+                if constexpr (std::endian::native == std::endian::little) word = std::byteswap(word);
+                buffer |= uint64_t(word) << (32 - count);
+                next += sizeof(word);
+                count += 32;
+            }
+            return buffer >> 32;
+        }
+
+        void skip(int bits) {
+            buffer <<= bits;
+            count -= bits;
+        }
+
+        uint32_t read(int bits) {
+            uint32_t value = (uint64_t(peek()) << bits) >> 32;
+            skip(bits);
+            return value;
+        }
+    };
+
+    /// Canonical Huffman code, codes are assigned in order of length then symbol. A code of one symbol takes no bits.
+    struct Code {
+        std::array<uint64_t, MAX_CODE_LENGTH + 1> limit{}; // End of the codes of each length, left aligned in 32 bits.
+        std::array<uint32_t, MAX_CODE_LENGTH + 1> first{}; // First code of each length.
+        std::array<uint16_t, MAX_CODE_LENGTH + 1> start{}; // Index in symbols of the first code of each length.
+        std::array<uint16_t, 1 << PEEK_BITS> peek{}; // (Length + 1) << 8 | symbol of the code starting with each prefix, 0 if longer.
+        std::vector<uint8_t> symbols; // In code order.
+        std::vector<uint32_t> codes; // Indexed by symbol.
+        std::vector<uint8_t> lengths; // Indexed by symbol.
+
+        Code(std::span<const uint8_t> code_lengths) : codes(code_lengths.size()), lengths(code_lengths.begin(), code_lengths.end()) {
+            if (std::count_if(lengths.begin(), lengths.end(), [](uint8_t len) { return len != 0; }) == 1) {
+                uint8_t symbol = std::find_if(lengths.begin(), lengths.end(), [](uint8_t len) { return len != 0; }) - lengths.begin();
+                lengths[symbol] = 0;
+                symbols.push_back(symbol);
+                peek.fill(1 << 8 | symbol);
+                return;
+            }
+
+            uint32_t code = 0;
+            for (int len = 1; len <= MAX_CODE_LENGTH; ++len) {
+                first[len] = code;
+                start[len] = symbols.size();
+                for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+                    if (lengths[symbol] != len) continue;
+                    if (len <= PEEK_BITS) {
+                        uint32_t prefix = code << (PEEK_BITS - len);
+                        std::fill_n(peek.begin() + prefix, 1 << (PEEK_BITS - len), (len + 1) << 8 | symbol);
+                    }
+                    codes[symbol] = code++;
+                    symbols.push_back(symbol);
+                }
+                limit[len] = uint64_t(code) << (32 - len);
+                code <<= 1;
+            }
+        }
+
+        uint8_t decode(BitReader& reader) const {
+            uint32_t window = reader.peek();
+            if (uint16_t entry = peek[window >> (32 - PEEK_BITS)]) {
+                reader.skip((entry >> 8) - 1);
+                return entry & 0xFF;
+            }
+
+            int len = PEEK_BITS + 1;
+            while (len < MAX_CODE_LENGTH && window >= limit[len]) len++;
+            reader.skip(len);
+            return symbols[start[len] + (window >> (32 - len)) - first[len]];
+        }
+    };
+
+    /// Huffman code lengths of the symbols with a nonzero count, the counts are halved until no code is too long.
+    std::vector<uint8_t> code_lengths(std::vector<uint64_t> counts) {
+        std::vector<uint8_t> lengths(counts.size());
+        while (true) {
+            using Node = std::pair<uint64_t, int>; // Count and node, symbols are the first nodes.
+            std::priority_queue<Node, std::vector<Node>, std::greater<>> heap;
+            std::vector<int> parent(counts.size(), -1);
+            for (int symbol = 0; symbol < static_cast<int>(counts.size()); ++symbol)
+                if (counts[symbol]) heap.push({ counts[symbol], symbol });
+
+            if (heap.size() == 1) lengths[heap.top().second] = 1;
+            if (heap.size() <= 1) return lengths;
+
+            while (heap.size() > 1) {
+                auto [count_a, a] = heap.top();
+                heap.pop();
+                auto [count_b, b] = heap.top();
+                heap.pop();
+                int node = parent.size();
+                parent[a] = parent[b] = node;
+                heap.push({ count_a + count_b, node });
+                parent.push_back(-1);
+            }
+
+            int longest = 0;
+            for (int symbol = 0; symbol < static_cast<int>(counts.size()); ++symbol) {
+                int len = 0;
+                for (int node = symbol; counts[symbol] && parent[node] >= 0; node = parent[node]) len++;
+                lengths[symbol] = len;
+                longest = std::max(longest, len);
+            }
+
+            if (longest <= MAX_CODE_LENGTH) return lengths;
+            for (uint64_t& count : counts) count = (count + 1) / 2;
+        }
+    }
+
+    /// Piece counts indexed by [colour][piece type], kings included.
+    struct Signature {
+        std::array<std::array<int, 6>, 2> counts{};
+
+        int total() const {
+            int sum = 0;
+            for (const auto& side : counts)
+                for (int count : side) sum += count;
+            return sum;
+        }
+
+        bool has_pawns() const { return counts[white][p] || counts[black][p]; }
+
+        Signature swapped() const { return { { counts[white], counts[black] } }; }
+
+        /// Material key of the signature, or of the swapped signature, as zobrist::gen_material_key.
+        Key key(bool swap) const {
+            Key key = 0;
+            for (Colour side : { black, white })
+                for (Piece piece = p; piece <= k; ++piece)
+                    for (int count = 0; count < counts[swap ? side ^ 1 : side][piece]; ++count)
+                        key ^= zobrist::piece_keys[((side == white ? P : p) + piece) * 64 + count];
+            return key;
+        }
+
+        std::string name() const {
+            std::string str;
+            for (Colour side : { white, black }) {
+                str += 'K';
+                for (Piece piece : SIGNATURE_ORDER)
+                    str.append(counts[side][piece], PIECE_CHARS[piece]);
+                if (side == white) str += 'v';
+            }
+            return str;
+        }
+
+        /// Stronger side first, by material then by the pieces in SIGNATURE_ORDER.
+        Signature canonical() const {
+            constexpr std::array<int, 6> values = { 1, 3, 3, 5, 9, 0 };
+            auto strength = [&](Colour side) {
+                std::array<int, 6> key{};
+                for (Piece piece = p; piece <= q; ++piece) key[0] += values[piece] * counts[side][piece];
+                for (size_t i = 0; i < SIGNATURE_ORDER.size(); ++i) key[i + 1] = counts[side][SIGNATURE_ORDER[i]];
+                return key;
+            };
+            return strength(black) > strength(white) ? swapped() : *this;
+        }
+
+        /// Parses names such as "KQvKR", both sides need exactly one king.
+        static std::optional<Signature> parse(std::string_view name) {
+            Signature sig;
+            Colour side = white;
+            for (char c : name) {
+                if (c == 'v' && side == white) {
+                    side = black;
+                    continue;
+                }
+
+                size_t piece = PIECE_CHARS.find(c);
+                if (piece == std::string_view::npos) return std::nullopt;
+                sig.counts[side][piece]++;
+            }
+
+            if (side != black || sig.counts[white][k] != 1 || sig.counts[black][k] != 1) return std::nullopt;
+            return sig;
+        }
+    };
+
+    /// King squares of the first king, a1-d1-d4 without pawns and files a-d with pawns.
+    constexpr auto king_squares = [](bool pawns) constexpr {
+        std::array<int, 64> index{};
+        int count = 0;
+        for (Square sq = 0; sq < 64; ++sq) {
+            bool used = (sq & 7) <= 3 && (pawns || (sq >> 3) <= (sq & 7));
+            index[sq] = used ? count++ : -1;
+        }
+        return index;
+    };
+
+    constexpr std::array<std::array<int, 64>, 2> KING_INDEX = { king_squares(false), king_squares(true) };
+    constexpr std::array<int, 2> KING_COUNT = { 10, 32 };
+
+    inline Square transform(Square sq, int t) {
+        if (t & 1) sq ^= 7;
+        if (t & 2) sq ^= 56;
+        if (t & 4) sq = ((sq & 7) << 3) | (sq >> 3);
+        return sq;
+    }
+
+    /// Symmetry bringing the first king into its reduced squares, pawns only allow the file mirror.
+    inline int king_transform(Square king, bool pawns) {
+        int t = get_file(king) > 3 ? 1 : 0;
+        if (pawns) return t;
+        if (get_rank(king) > 3) t |= 2;
+        king = transform(king, t);
+        if (get_rank(king) > get_file(king)) t |= 4;
+        return t;
+    }
+
+    /// Index of a position: side to move, the white king, then every other piece on 64 squares.
+    /// Identical pieces are stored in ascending square order, other orders are unused indices.
+    struct Layout {
+        std::vector<Piece> pieces; // After the white king: white pieces, the black king, black pieces.
+        bool pawns;
+        uint64_t size;
+
+        Layout(const Signature& sig) : pawns(sig.has_pawns()) {
+            for (Colour side : { white, black }) {
+                Piece offset = side == white ? P : p;
+                if (side == black) pieces.push_back(k);
+                for (Piece piece : SIGNATURE_ORDER)
+                    pieces.insert(pieces.end(), sig.counts[side][piece], offset + piece);
+            }
+
+            size = 2 * KING_COUNT[pawns];
+            for (size_t i = 0; i < pieces.size(); ++i) size *= 64;
+        }
+
+        /// Index of squares given in layout order, the white king first.
+        uint64_t encode(std::array<Square, tablebase::MAX_PIECES> squares, Colour stm) const {
+            int t = king_transform(squares[0], pawns);
+            uint64_t idx = stm * KING_COUNT[pawns] + KING_INDEX[pawns][transform(squares[0], t)];
+
+            for (size_t i = 1; i <= pieces.size(); ++i) squares[i] = transform(squares[i], t);
+            for (size_t i = 0; i < pieces.size();) {
+                size_t end = i + 1;
+                while (end < pieces.size() && pieces[end] == pieces[i]) end++;
+                std::sort(squares.begin() + i + 1, squares.begin() + end + 1);
+                i = end;
+            }
+
+            for (size_t i = 1; i <= pieces.size(); ++i) idx = idx * 64 + squares[i];
+            return idx;
+        }
+
+        /// Index of a position of this signature, or of its swapped signature with the colours exchanged.
+        uint64_t encode(const BoardState& state, bool swap) const {
+            auto real_piece = [&](Piece piece) { return swap ? (piece < P ? piece + P : piece - P) : piece; };
+            auto frame = [&](Square sq) { return swap ? flip_rank(sq) : sq; };
+
+            std::array<Square, tablebase::MAX_PIECES> squares;
+            squares[0] = frame(bitscan_forward(state.bitboards[real_piece(K)]));
+            for (size_t i = 0; i < pieces.size();) {
+                BB bb = state.bitboards[real_piece(pieces[i])];
+                while (bb) {
+                    Square sq = bitscan_forward(bb);
+                    pop_bit(bb, sq);
+                    squares[++i] = frame(sq);
+                }
+            }
+
+            return encode(squares, swap ? state.side_to_move ^ 1 : state.side_to_move);
+        }
+
+        /// Squares of the white king then pieces, false if two pieces share a square or a pawn is on a back rank.
+        bool decode(uint64_t idx, std::array<Square, tablebase::MAX_PIECES>& squares, Colour& stm) const {
+            for (size_t i = pieces.size(); i-- > 0;) {
+                squares[i + 1] = idx & 63;
+                idx >>= 6;
+            }
+
+            int king = idx % KING_COUNT[pawns];
+            stm = idx / KING_COUNT[pawns];
+            squares[0] = std::find(KING_INDEX[pawns].begin(), KING_INDEX[pawns].end(), king) - KING_INDEX[pawns].begin();
+
+            BB occ = 0;
+            for (size_t i = 0; i <= pieces.size(); ++i) {
+                if (get_bit(occ, squares[i])) return false;
+                occ |= mask(squares[i]);
+                if (i > 0 && pieces[i - 1] % 6 == p && (get_rank(squares[i]) == 0 || get_rank(squares[i]) == 7))
+                    return false;
+            }
+
+            return true;
+        }
+    };
+
+    /// Read only view of a table file, memory mapped where supported.
+    class MappedFile {
+    private:
+        const uint8_t* ptr = nullptr;
+        size_t len = 0;
+#ifdef _WIN32
+        std::vector<uint8_t> buffer;
+#endif
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+#ifndef _WIN32
+            if (ptr) munmap(const_cast<uint8_t*>(ptr), len);
+#endif
+        }
+
+        bool open(const std::filesystem::path& path) {
+#ifdef _WIN32
+            std::ifstream file(path, std::ios::binary);
+            buffer.assign(std::istreambuf_iterator<char>(file), {});
+            ptr = buffer.data();
+            len = buffer.size();
+            return !buffer.empty();
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                close(fd);
+                return false;
+            }
+
+            void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (map == MAP_FAILED) return false;
+
+            ptr = static_cast<const uint8_t*>(map);
+            len = st.st_size;
+            return true;
+#endif
+        }
+
+        const uint8_t* data() const { return ptr; }
+        size_t size() const { return len; }
+    };
+
+    struct Table {
+        Signature signature;
+        Layout layout;
+        uint32_t max_dtm;
+        std::vector<Code> value_codes; // Indexed by the value of the run before.
+        std::vector<Code> run_codes; // Run length classes, indexed by the value of the run.
+        const uint64_t* group_offsets;
+        const uint16_t* block_offsets;
+        const uint8_t* blocks;
+        std::unique_ptr<MappedFile> file;
+
+        Table(const Signature& sig) : signature(sig), layout(sig) {}
+
+        uint8_t get(uint64_t idx) const {
+            uint64_t block = idx / BLOCK_SIZE;
+            BitReader reader(blocks + group_offsets[block / GROUP_SIZE] + block_offsets[block]);
+            uint32_t pos = idx % BLOCK_SIZE;
+            for (uint8_t value = tablebase::DRAW;;) {
+                value = value_codes[value].decode(reader);
+                int run_class = run_codes[value].decode(reader);
+                uint32_t length = 1 << (run_class - 1) | reader.read(run_class - 1);
+                if (pos < length) return value;
+                pos -= length;
+            }
+        }
+    };
+
+    constexpr size_t lengths_size(uint32_t symbols) { return (symbols * (symbols + RUN_CLASSES) + 7) / 8 * 8; }
+
+    std::vector<std::unique_ptr<Table>> tables;
+    std::unordered_map<Key, std::pair<const Table*, bool>> tables_by_key; // Table and whether colours are swapped.
+
+    bool load_table(const std::filesystem::path& path) {
+        auto file = std::make_unique<MappedFile>();
+        if (!file->open(path) || file->size() < sizeof(FileHeader)) return false;
+
+        FileHeader header;
+        std::memcpy(&header, file->data(), sizeof(FileHeader));
+        header.name.back() = '\0';
+        auto sig = Signature::parse(std::string_view(header.name.data()));
+        if (header.magic != MAGIC || !sig) return false;
+
+        auto table = std::make_unique<Table>(*sig);
+        if (table->layout.size != header.size || header.blocks != (header.size + BLOCK_SIZE - 1) / BLOCK_SIZE
+            || header.symbols == 0 || header.symbols > 256)
+            return false;
+
+        const uint8_t* lengths = file->data() + sizeof(FileHeader);
+        const uint8_t* run_lengths = lengths + header.symbols * header.symbols;
+        for (uint32_t value = 0; value < header.symbols; ++value) {
+            table->value_codes.emplace_back(std::span(lengths + value * header.symbols, header.symbols));
+            table->run_codes.emplace_back(std::span(run_lengths + value * RUN_CLASSES, RUN_CLASSES));
+        }
+
+        table->max_dtm = header.max_dtm;
+        uint64_t groups = (header.blocks + GROUP_SIZE - 1) / GROUP_SIZE;
+        table->group_offsets = reinterpret_cast<const uint64_t*>(lengths + lengths_size(header.symbols));
+        table->block_offsets = reinterpret_cast<const uint16_t*>(table->group_offsets + groups);
+        table->blocks = reinterpret_cast<const uint8_t*>(table->block_offsets) + (header.blocks * sizeof(uint16_t) + 7) / 8 * 8;
+        table->file = std::move(file);
+
+        tables_by_key[sig->key(false)] = { table.get(), false };
+        if (sig->key(true) != sig->key(false))
+            tables_by_key[sig->key(true)] = { table.get(), true };
+
+        tablebase::max_pieces = std::max(tablebase::max_pieces, sig->total());
+        tables.push_back(std::move(table));
+        return true;
+    }
+
+    /// Value after a move into a child of value child, from the mover's view.
+    inline uint8_t parent_value(uint8_t child) {
+        if (child == tablebase::DRAW || child > tablebase::MAX_DTM) return tablebase::DRAW;
+        return child + 1;
+    }
+
+    inline bool is_win(uint8_t value) { return value != tablebase::DRAW && (value - 1) % 2 == 1; }
+
+    /// Orders values for the side to move: shorter wins, draws, then longer losses.
+    inline int preference(uint8_t value) {
+        if (value == tablebase::DRAW) return 0;
+        int dtm = value - 1;
+        return is_win(value) ? 1000 - dtm : -1000 + dtm;
+    }
+
+    inline bool is_ep_possible(const BoardState& state) {
+        Colour us = state.side_to_move;
+        return state.enpassant_square != no_square
+            && (pawn_attack_table[state.enpassant_square][us ^ 1] & state.bitboards[us == white ? P : p]);
+    }
+
+    /// Whether the side to move can capture the opponent king. Board::sq_attacked_by also counts x-rays, so it is not used here.
+    inline bool is_king_attacked(const BoardState& state, Colour us) {
+        Square king_sq = bitscan_forward(state.bitboards[us == white ? k : K]);
+        BB occ = state.bitboards[allpieces];
+        BB attackers = (pawn_attack_table[king_sq][us ^ 1] & state.bitboards[us == white ? P : p])
+                     | (knight_attacks(mask(king_sq)) & state.bitboards[us == white ? N : n])
+                     | (king_move_table[king_sq] & state.bitboards[us == white ? K : k])
+                     | (bishop_moves(king_sq, occ) & (state.bitboards[us == white ? B : b] | state.bitboards[us == white ? Q : q]))
+                     | (rook_moves(king_sq, occ) & (state.bitboards[us == white ? R : r] | state.bitboards[us == white ? Q : q]));
+        return attackers;
+    }
+
+    template <typename Lookup>
+    int position_value(Board& board, const Lookup& lookup, Move* best_move = nullptr);
+
+    /// Value of the position after a move, searching one ply further when an en passant capture is possible.
+    template <typename Lookup>
+    int child_value(Board& board, const Lookup& lookup) {
+        return is_ep_possible(board.state) ? position_value(board, lookup) : lookup(board.state);
+    }
+
+    /// Best value over the moves of the position, or -1 if a child is not known.
+    template <typename Lookup>
+    int position_value(Board& board, const Lookup& lookup, Move* best_move) {
+        board.generate_moves<ALLMOVES>();
+        if (board.state.move_list.is_empty()) return board.state.is_in_check ? 1 : tablebase::DRAW;
+
+        int best = INT_MIN;
+        uint8_t best_value = tablebase::DRAW;
+        for (Move move : board.state.move_list) {
+            board.make_move(move);
+            int child = child_value(board, lookup);
+            board.unmake_last_move();
+            if (child < 0) return -1;
+
+            uint8_t value = parent_value(child);
+            if (preference(value) > best) {
+                best = preference(value);
+                best_value = value;
+                if (best_move) *best_move = move;
+            }
+        }
+
+        return best_value;
+    }
+
+    /// Writes the table, the unused indices of values are overwritten.
+    bool write_table(const std::filesystem::path& path, const Signature& sig, std::vector<uint8_t>& values, uint32_t max_dtm) {
+        // Unused indices are never probed, they extend the run before them.
+        for (uint64_t idx = 0; idx < values.size(); ++idx)
+            if (values[idx] == tablebase::INVALID) values[idx] = idx % BLOCK_SIZE ? values[idx - 1] : tablebase::DRAW;
+
+        // Calls visit(first, before, value, length) for each run of each block, first is set for the first run of a block.
+        auto for_each_run = [&](auto&& visit) {
+            for (uint64_t start = 0; start < values.size(); start += BLOCK_SIZE) {
+                uint64_t end = std::min<uint64_t>(start + BLOCK_SIZE, values.size());
+                uint8_t before = tablebase::DRAW;
+                for (uint64_t idx = start; idx < end;) {
+                    uint64_t run_end = idx + 1;
+                    while (run_end < end && values[run_end] == values[idx]) run_end++;
+                    visit(idx == start, before, values[idx], run_end - idx);
+                    before = values[idx];
+                    idx = run_end;
+                }
+            }
+        };
+
+        uint32_t symbols = *std::max_element(values.begin(), values.end()) + 1;
+        std::vector<std::vector<uint64_t>> value_counts(symbols, std::vector<uint64_t>(symbols));
+        std::vector<std::vector<uint64_t>> run_counts(symbols, std::vector<uint64_t>(RUN_CLASSES));
+        for_each_run([&](bool, uint8_t before, uint8_t value, uint64_t length) {
+            value_counts[before][value]++;
+            run_counts[value][std::bit_width(length)]++;
+        });
+
+        std::vector<uint8_t> lengths(lengths_size(symbols));
+        std::vector<Code> value_codes, run_codes;
+        for (uint32_t value = 0; value < symbols; ++value) {
+            std::vector<uint8_t> code = code_lengths(value_counts[value]);
+            std::copy(code.begin(), code.end(), lengths.begin() + value * symbols);
+            value_codes.emplace_back(code);
+
+            code = code_lengths(run_counts[value]);
+            std::copy(code.begin(), code.end(), lengths.begin() + symbols * symbols + value * RUN_CLASSES);
+            run_codes.emplace_back(code);
+        }
+
+        std::vector<uint64_t> group_offsets;
+        std::vector<uint16_t> block_offsets;
+        std::vector<uint8_t> data;
+        uint64_t bit = 0;
+        auto put = [&](uint32_t bits, int count) {
+            for (int i = count; i-- > 0; ++bit) {
+                if (bit % 8 == 0) data.push_back(0);
+                data.back() |= (bits >> i & 1) << (7 - bit % 8);
+            }
+        };
+
+        for_each_run([&](bool first, uint8_t before, uint8_t value, uint64_t length) {
+            if (first) {
+                if (block_offsets.size() % GROUP_SIZE == 0) group_offsets.push_back(data.size());
+                block_offsets.push_back(data.size() - group_offsets.back());
+                bit = data.size() * 8;
+            }
+
+            int run_class = std::bit_width(length);
+            put(value_codes[before].codes[value], value_codes[before].lengths[value]);
+            put(run_codes[value].codes[run_class], run_codes[value].lengths[run_class]);
+            put(length, run_class - 1);
+        });
+        data.resize(data.size() + sizeof(uint64_t));
+        block_offsets.resize((block_offsets.size() + 3) / 4 * 4);
+
+        FileHeader header{};
+        header.magic = MAGIC;
+        header.size = values.size();
+        header.blocks = (values.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        header.max_dtm = max_dtm;
+        header.symbols = symbols;
+        std::string name = sig.name();
+        std::copy(name.begin(), name.end(), header.name.begin());
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(lengths.data()), lengths.size());
+        file.write(reinterpret_cast<const char*>(group_offsets.data()), group_offsets.size() * sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(block_offsets.data()), block_offsets.size() * sizeof(uint16_t));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return file.good();
+    }
+
+    /// Signatures reached by a capture or a promotion.
+    std::vector<Signature> conversions(const Signature& sig) {
+        std::vector<Signature> result;
+        for (Colour side : { white, black }) {
+            for (Piece piece = p; piece <= q; ++piece) {
+                if (sig.counts[side][piece] == 0) continue;
+
+                Signature captured = sig;
+                captured.counts[side][piece]--;
+                result.push_back(captured.canonical());
+
+                if (piece != p) continue;
+                for (Piece promo = n; promo <= q; ++promo) {
+                    Signature promoted = captured;
+                    promoted.counts[side][promo]++;
+                    result.push_back(promoted.canonical());
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /// Calls mark with the index of every position one move of the side that did not move away from squares.
+    /// Only moves within the signature are undone, captures and promotions come from other tables.
+    template <typename Mark>
+    void for_each_parent(const Layout& layout, const std::vector<Piece>& pieces,
+                         std::array<Square, tablebase::MAX_PIECES> squares, Colour stm, const Mark& mark) {
+        Colour mover = stm ^ 1;
+        BB occ = 0;
+        for (size_t i = 0; i < pieces.size(); ++i) occ |= mask(squares[i]);
+
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            if ((pieces[i] >= P ? white : black) != mover) continue;
+
+            Square from = squares[i];
+            BB targets = 0;
+            switch (pieces[i] % 6) {
+                case n: targets = knight_move_table[from]; break;
+                case b: targets = bishop_moves(from, occ); break;
+                case r: targets = rook_moves(from, occ); break;
+                case q: targets = bishop_moves(from, occ) | rook_moves(from, occ); break;
+                case k: targets = king_move_table[from]; break;
+                case p: {
+                    int back = mover == white ? -8 : 8;
+                    int rank = mover == white ? get_rank(from) : 7 - get_rank(from);
+                    if (rank >= 2 && !get_bit(occ, from + back)) {
+                        targets = mask(from + back);
+                        if (rank == 3 && !get_bit(occ, from + 2 * back)) targets |= mask(from + 2 * back);
+                    }
+                }
+            }
+
+            targets &= ~occ;
+            while (targets) {
+                squares[i] = bitscan_forward(targets);
+                pop_bit(targets, squares[i]);
+                mark(layout.encode(squares, mover));
+
+                // Kings on the long diagonal have both diagonal mirrors indexed.
+                if (!layout.pawns) {
+                    std::array<Square, tablebase::MAX_PIECES> mirrored;
+                    for (size_t j = 0; j < pieces.size(); ++j) mirrored[j] = transform(squares[j], 4);
+                    mark(layout.encode(mirrored, mover));
+                }
+            }
+            squares[i] = from;
+        }
+    }
+
+    /// Retrograde analysis: pass k finds the wins in k plies when k is odd, and the losses in k plies when even.
+    /// Positions are verified forwards with generate_moves, the candidates of each pass are the predecessors of
+    /// the positions resolved in the last pass and those whose best capture or promotion resolves them.
+    bool generate_table(const Signature& sig, int threads) {
+        if (sig.total() == 2 || tables_by_key.contains(sig.key(false))) return true;
+
+        for (const Signature& sub : conversions(sig))
+            if (!generate_table(sub, threads)) return false;
+
+        std::string name = sig.name();
+        Layout layout(sig);
+        std::println("info string generating {}, {} positions", name, layout.size);
+        std::fflush(stdout);
+        auto start = std::chrono::steady_clock::now();
+
+        Key key = sig.key(false);
+        std::vector<Piece> pieces = { K };
+        pieces.insert(pieces.end(), layout.pieces.begin(), layout.pieces.end());
+
+        // A resolved position holds its value, an unresolved one the best value over its captures and promotions.
+        // Positions resolve in the pass of their distance, so those resolved in the last pass hold the pass.
+        std::vector<uint8_t> values(layout.size, tablebase::DRAW);
+        std::vector<uint64_t> resolved((layout.size + 63) / 64); // Bitsets of positions.
+        std::vector<uint64_t> candidates((layout.size + 63) / 64);
+        std::vector<uint64_t> ep_parents(layout.pawns ? (layout.size + 63) / 64 : 0); // Moves allowing en passant are searched a ply deeper.
+
+        // The value of a position is stored before it is set resolved.
+        auto set = [](std::vector<uint64_t>& bits, uint64_t idx) {
+            std::atomic_ref<uint64_t>(bits[idx / 64]).fetch_or(uint64_t(1) << (idx % 64), std::memory_order_release);
+        };
+
+        auto test = [](std::vector<uint64_t>& bits, uint64_t idx) -> bool {
+            return std::atomic_ref<uint64_t>(bits[idx / 64]).load(std::memory_order_acquire) >> (idx % 64) & 1;
+        };
+
+        auto lookup = [&](const BoardState& state) -> int {
+            if (state.material_key == key) {
+                uint64_t idx = layout.encode(state, false);
+                return test(resolved, idx) ? std::atomic_ref<uint8_t>(values[idx]).load(std::memory_order_relaxed) : tablebase::DRAW;
+            }
+            uint8_t value;
+            return tablebase::probe(state, value) ? value : -1;
+        };
+
+        // Boards are built up front, their constructors initialise shared tables.
+        std::vector<std::unique_ptr<Board>> boards;
+        for (int i = 0; i < threads; ++i) boards.push_back(std::make_unique<Board>());
+
+        // Runs work(board, lo, hi) over chunks of indices on every thread.
+        auto parallel = [&](auto&& work) {
+            constexpr uint64_t CHUNK = 1 << 16;
+            std::atomic<uint64_t> next_chunk = 0;
+            auto worker = [&](Board& board) {
+                for (uint64_t lo; (lo = next_chunk.fetch_add(CHUNK)) < layout.size;)
+                    work(board, lo, std::min(lo + CHUNK, layout.size));
+            };
+
+            std::vector<std::thread> workers;
+            for (int i = 1; i < threads; ++i) workers.emplace_back(worker, std::ref(*boards[i]));
+            worker(*boards[0]);
+            for (std::thread& thread : workers) thread.join();
+        };
+
+        std::atomic<bool> failed = false;
+        std::atomic<uint64_t> found = 0;
+        std::atomic<int> conversion_max = 0;
+
+        // Pass 0: unused indices, mates, and the values of captures and promotions.
+        parallel([&](Board& board, uint64_t lo, uint64_t hi) {
+            std::array<Square, tablebase::MAX_PIECES> squares;
+            int local_max = 0;
+            for (uint64_t idx = lo; idx < hi; ++idx) {
+                Colour stm;
+                if (!layout.decode(idx, squares, stm)) {
+                    values[idx] = tablebase::INVALID;
+                    set(resolved, idx);
+                    continue;
+                }
+
+                board.load_pieces(pieces, std::span(squares.data(), pieces.size()), stm);
+
+                // Other orders of identical pieces and positions with the side not to move in check are never probed.
+                if (layout.encode(board.state, false) != idx || is_king_attacked(board.state, stm)) {
+                    values[idx] = tablebase::INVALID;
+                    set(resolved, idx);
+                    continue;
+                }
+
+                board.generate_moves<ALLMOVES>();
+                if (board.state.move_list.is_empty()) {
+                    if (board.state.is_in_check) {
+                        values[idx] = 1;
+                        set(resolved, idx);
+                        found++;
+                    }
+                    continue;
+                }
+
+                uint8_t best = tablebase::DRAW;
+                bool has_conversion = false;
+                for (Move move : board.state.move_list) {
+                    board.make_move(move);
+                    bool ep = is_ep_possible(board.state);
+                    int child = board.state.material_key != key ? child_value(board, lookup) : tablebase::DRAW;
+                    bool converts = board.state.material_key != key;
+                    board.unmake_last_move();
+
+                    if (ep) set(ep_parents, idx);
+                    if (!converts) continue;
+                    if (child < 0) {
+                        failed = true;
+                        return;
+                    }
+
+                    uint8_t value = parent_value(child);
+                    if (!has_conversion || preference(value) > preference(best)) best = value;
+                    has_conversion = true;
+                }
+
+                values[idx] = best;
+                if (best != tablebase::DRAW) local_max = std::max(local_max, best - 1);
+            }
+
+            for (int max = conversion_max; local_max > max && !conversion_max.compare_exchange_weak(max, local_max);) {}
+        });
+
+        uint32_t max_dtm = 0;
+        int empty_passes = found.exchange(0) ? 0 : 1;
+        for (int pass = 1; pass <= tablebase::MAX_DTM && !failed; ++pass) {
+            // Positions resolve in order of distance, nothing is left after empty passes beyond the conversions.
+            if (empty_passes >= 2 && pass > conversion_max + 1) break;
+
+            std::fill(candidates.begin(), candidates.end(), 0);
+            parallel([&](Board&, uint64_t lo, uint64_t hi) {
+                std::array<Square, tablebase::MAX_PIECES> squares;
+                for (uint64_t idx = lo; idx < hi; ++idx) {
+                    bool is_resolved = test(resolved, idx);
+                    if ((!is_resolved && values[idx] == pass + 1) || (layout.pawns && test(ep_parents, idx)))
+                        set(candidates, idx);
+
+                    if (!is_resolved || values[idx] != pass) continue;
+
+                    Colour stm;
+                    layout.decode(idx, squares, stm);
+                    for_each_parent(layout, pieces, squares, stm, [&](uint64_t parent) { set(candidates, parent); });
+                }
+            });
+
+            parallel([&](Board& board, uint64_t lo, uint64_t hi) {
+                std::array<Square, tablebase::MAX_PIECES> squares;
+                for (uint64_t idx = lo; idx < hi; ++idx) {
+                    if (!(candidates[idx / 64] >> (idx % 64) & 1) || test(resolved, idx)) continue;
+
+                    Colour stm;
+                    layout.decode(idx, squares, stm);
+                    board.load_pieces(pieces, std::span(squares.data(), pieces.size()), stm);
+                    board.generate_moves<ALLMOVES>();
+
+                    uint8_t result = tablebase::DRAW;
+                    uint8_t longest_loss = 0;
+                    bool all_lost = !board.state.move_list.is_empty();
+                    for (Move move : board.state.move_list) {
+                        board.make_move(move);
+                        int child = child_value(board, lookup);
+                        board.unmake_last_move();
+                        if (child < 0) {
+                            failed = true;
+                            return;
+                        }
+
+                        uint8_t value = parent_value(child);
+                        if (pass % 2 == 1 && is_win(value) && value - 1 <= pass) {
+                            result = value;
+                            break;
+                        }
+
+                        // A move that does not lose rules out a loss in this pass.
+                        if (value == tablebase::DRAW || is_win(value)) {
+                            all_lost = false;
+                            if (pass % 2 == 0) break;
+                        } else {
+                            longest_loss = std::max(longest_loss, value);
+                        }
+                    }
+
+                    if (pass % 2 == 0 && all_lost && longest_loss - 1 == pass) result = longest_loss;
+                    if (result != tablebase::DRAW) {
+                        std::atomic_ref<uint8_t>(values[idx]).store(result, std::memory_order_relaxed);
+                        set(resolved, idx);
+                        found++;
+                    }
+                }
+            });
+
+            bool progress = found.exchange(0);
+            if (progress) max_dtm = pass;
+            empty_passes = progress ? 0 : empty_passes + 1;
+        }
+
+        if (failed) {
+            std::println("info string {} is missing a table it converts into", name);
+            return false;
+        }
+
+        // Positions left unresolved are draws, whatever their captures and promotions are worth.
+        for (uint64_t idx = 0; idx < layout.size; ++idx)
+            if (!(resolved[idx / 64] >> (idx % 64) & 1)) values[idx] = tablebase::DRAW;
+
+        std::filesystem::path path = tb_path / (name + ".ctb");
+        if (!write_table(path, sig, values, max_dtm) || !load_table(path)) {
+            std::println("info string could not write {}", path.string());
+            return false;
+        }
+
+        std::println("info string {} done, longest mate {} plies, {}ms", name, max_dtm, elapsed_ms(start));
+        std::fflush(stdout);
+        return true;
+    }
+}
+
+int tablebase::init(const std::filesystem::path& dir) {
+    tables_by_key.clear();
+    tables.clear();
+    max_pieces = 0;
+
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(dir, ec))
+        if (file.path().extension() == ".ctb") load_table(file.path());
+
+    return tables.size();
+}
+
+bool tablebase::probe(const BoardState& state, uint8_t& value) {
+    if (state.castling_rights || is_ep_possible(state)) return false;
+
+    if (pop_count(state.bitboards[allpieces]) == 2) {
+        value = DRAW;
+        return true;
+    }
+
+    auto it = tables_by_key.find(state.material_key);
+    if (it == tables_by_key.end()) return false;
+
+    auto [table, swap] = it->second;
+    value = table->get(table->layout.encode(state, swap));
+    return true;
+}
+
+Score tablebase::value_to_score(uint8_t value, int ply) {
+    if (value == DRAW) return 0;
+    int dtm = value - 1;
+    return is_win(value) ? MATE_VALUE - ply - dtm : -MATE_VALUE + ply + dtm;
+}
+
+Move tablebase::probe_root(Board& board, Score& score) {
+    uint8_t root;
+    if (!probe(board.state, root)) return nullmove;
+
+    auto lookup = [](const BoardState& state) -> int {
+        uint8_t value;
+        return probe(state, value) ? value : -1;
+    };
+
+    Move best_move = nullmove;
+    int value = position_value(board, lookup, &best_move);
+    if (value < 0 || best_move == nullmove) return nullmove;
+
+    score = value_to_score(value, 0);
+    return best_move;
+}
+
+bool tablebase::generate(const std::string& material, int threads) {
+    auto sig = Signature::parse(material);
+    if (!sig || sig->total() > MAX_PIECES) {
+        std::println("info string invalid material {}, expected up to {} pieces such as KRPvKR", material, MAX_PIECES);
+        return false;
+    }
+
+    std::filesystem::create_directories(tb_path);
+    init(tb_path);
+    return generate_table(sig->canonical(), std::max(threads, 1));
+}
@@ -1,15 +1,41 @@
 #include "../include/tests.hpp"
 #include "../include/board.hpp"
 #include "../include/utils.hpp"
+#include "../include/move_gen.hpp"
+#include "../include/search.hpp"
+#include "../include/transposition.hpp"
+#include "../include/nnue.hpp"
+#include "../include/eval.hpp"
+#include "../include/material.hpp"
+#include "../include/profiler.hpp"
+#include "../include/perf_counters.hpp"
 
 #include <print>
 #include <chrono>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <x86intrin.h>
 
 namespace tests {
 
     long positions_searched = 0;
     Board test_board;
 
+    /// Positions searched by bench, also the starting points of the evalcost games.
+    constexpr std::array<const char*, 8> bench_fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+        "2r3k1/pp3ppp/4p3/3pP3/3P4/P4N2/1P3PPP/2R3K1 w - - 0 24",
+        "8/5pk1/6p1/3R4/7P/6P1/r4PK1/8 b - - 3 41"
+    };
+
     /// Runs a normal perft test on test_board. See https://www.chessprogramming.org/Perft#Perft_function.
     void perft(int depth) {
         if (depth <= 0) {
@@ -20,7 +46,11 @@ namespace tests {
         test_board.generate_moves<ALLMOVES>();
 
         for (Move move : test_board.state.move_list) {
+#ifndef NDEBUG
+            bool gives_check = test_board.gives_check(move);
+#endif
             test_board.make_move(move);
+            assert(gives_check == test_board.state.is_in_check);
             perft(depth - 1);
             test_board.unmake_last_move();
         }
@@ -90,4 +120,322 @@ namespace tests {
         test(1, 4, false);
     }
 
+
+    /// Times generate_moves and sq_attacked_by with the magic and PEXT slider backends.
+    void slider_bench() {
+        constexpr std::array<const char*, 6> fens = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+        };
+        constexpr int iterations = 200000;
+
+        bool cpu_backend = move_generator::use_pext;
+        std::println("CPU backend: {}", cpu_backend ? "pext" : "magic");
+
+        for (bool pext : { false, true }) {
+            if (pext && !move_generator::cpu_has_fast_pext()) {
+                std::println("pext: not supported by this CPU");
+                continue;
+            }
+
+            move_generator::use_pext = pext;
+            double gen_ns = 0, att_ns = 0;
+            BB sink = 0;
+
+            for (const char* fen : fens) {
+                test_board.load_fen(fen);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < iterations; ++i) {
+                    test_board.generate_moves<ALLMOVES>();
+                    sink += test_board.state.move_list.size();
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                gen_ns += std::chrono::duration<double, std::nano>(end - start).count();
+
+                BB occ = test_board.state.bitboards[allpieces];
+                start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < iterations / 64; ++i) {
+                    for (Square sq = 0; sq < 64; ++sq)
+                        sink ^= test_board.sq_attacked_by(occ ^ i, sq);
+                }
+                end = std::chrono::high_resolution_clock::now();
+                att_ns += std::chrono::duration<double, std::nano>(end - start).count();
+            }
+
+            std::println("{}: generate_moves {} ns/call, sq_attacked_by {} ns/call (sink {})",
+                         pext ? "pext" : "magic",
+                         gen_ns / (iterations * fens.size()),
+                         att_ns / ((iterations / 64) * 64 * fens.size()),
+                         sink & 1);
+        }
+
+        move_generator::use_pext = cpu_backend;
+    }
+
+    /// Prints the hardware counters of a bench as totals, IPC and misses per node.
+    void print_perf(const PerfCounters& counters, long bench_nodes) {
+        if (!counters.is_any_available()) {
+            std::println("info string perf counters unavailable");
+            return;
+        }
+
+        for (int event = 0; event < PerfCounters::NUM_EVENTS; ++event) {
+            auto e = static_cast<PerfCounters::Event>(event);
+            if (!counters.is_available(e))
+                std::println("info string perf {} unavailable", PerfCounters::names[e]);
+            else
+                std::println("info string perf {} {} per node {:.2f}", PerfCounters::names[e], counters.value(e),
+                    static_cast<double>(counters.value(e)) / std::max(bench_nodes, 1L));
+        }
+
+        if (counters.is_available(PerfCounters::CYCLES) && counters.is_available(PerfCounters::INSTRUCTIONS))
+            std::println("info string perf ipc {:.2f}", static_cast<double>(counters.value(PerfCounters::INSTRUCTIONS))
+                / std::max<uint64_t>(counters.value(PerfCounters::CYCLES), 1));
+    }
+
+    /// Searches a fixed set of positions to a fixed depth and reports the total nodes and NPS.
+    /// With use_perf, also the hardware counters of the searches.
+    void bench(int depth, bool use_perf) {
+        std::println("info string bench evaluation {}", nnue::is_enabled() ? "nnue" : "classical");
+        long bench_nodes = 0;
+        std::optional<PerfCounters> counters;
+        if (use_perf) counters.emplace();
+        auto start = std::chrono::steady_clock::now();
+#ifdef ENGINE_PROFILE
+        profiler::reset();
+#endif
+
+        for (const char* fen : bench_fens) {
+            test_board = Board(fen);
+            test_board.clean_search();
+            game_table->clear_tt();
+            test_board.search_params = SearchParams();
+            test_board.search_params.max_depth = depth;
+            stop_flag.store(false);
+            if (counters) counters->start();
+            test_board.run_search();
+            if (counters) counters->stop();
+            bench_nodes += total_nodes;
+        }
+
+        int elapsed = std::max(elapsed_ms(start), 1);
+        std::println("info string bench nodes {} time {} nps {}", bench_nodes, elapsed, bench_nodes * 1000 / elapsed);
+        if (counters) print_perf(*counters, bench_nodes);
+#ifdef ENGINE_PROFILE
+        profiler::report();
+#endif
+    }
+
+    /// Checks the KPK bitbase against positions with known results.
+    void kpk_suite() {
+        struct KPKTest { const char* fen; bool win; };
+        constexpr std::array<KPKTest, 12> positions = {{
+            { "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", true },   // King on the 6th in front of the pawn
+            { "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", true },
+            { "8/4k3/8/4K3/4P3/8/8/8 w - - 0 1", false },  // Defender has the opposition
+            { "8/4k3/8/4K3/4P3/8/8/8 b - - 0 1", true },   // Attacker has the opposition
+            { "4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", false },  // Stalemate
+            { "k7/8/8/8/8/8/P7/K7 w - - 0 1", false },     // Rook pawn, defender in the corner
+            { "7k/8/8/8/8/8/P7/K7 b - - 0 1", true },      // Outside the square
+            { "8/8/8/8/8/1k6/P7/K7 b - - 0 1", false },    // Pawn falls
+            { "4k3/8/3K4/3P4/8/8/8/8 w - - 0 1", true },
+            { "8/8/8/8/4p3/4k3/8/4K3 b - - 0 1", true },   // Black pawn
+            { "8/8/8/8/4p3/4k3/8/4K3 w - - 0 1", true },
+            { "8/8/8/8/8/8/k6p/7K w - - 0 1", false }      // Black rook pawn, defender in the corner
+        }};
+
+        int passed = 0;
+        for (const auto& [fen, win] : positions) {
+            test_board = Board(fen);
+            Score score = 0;
+            bool found = test_board.probe_bitbase(score);
+            bool ok = found && (score != 0) == win;
+            passed += ok;
+            std::println("{} {} expected {}", ok ? "OK  " : "FAIL", fen, win ? "win" : "draw");
+        }
+
+        std::println("info string kpk suite passed {} of {}", passed, positions.size());
+    }
+
+    /// Writes a network of random weights in the format nnue::load reads.
+    void write_random_network(const std::filesystem::path& path, std::mt19937& rng) {
+        std::ofstream file(path, std::ios::binary);
+        auto write = [&]<typename T>(size_t size, int lo, int hi, T) {
+            std::uniform_int_distribution<int> dist(lo, hi);
+            for (size_t i = 0; i < size; ++i) {
+                T value = dist(rng);
+                file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+            }
+        };
+
+        file.write("CNN1", 4);
+        for (uint32_t dim : { nnue::HALF_DIMS, nnue::L1_DIMS, nnue::L2_DIMS })
+            file.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+
+        write(nnue::HALF_DIMS, 0, 64, int16_t{});
+        write(size_t(nnue::FEATURES) * nnue::HALF_DIMS, -24, 24, int16_t{});
+        write(nnue::L1_DIMS, -2000, 2000, int32_t{});
+        write(nnue::L1_DIMS * 2 * nnue::HALF_DIMS, -64, 64, int8_t{});
+        write(nnue::L2_DIMS, -2000, 2000, int32_t{});
+        write(nnue::L2_DIMS * nnue::L1_DIMS, -64, 64, int8_t{});
+        write(1, -2000, 2000, int32_t{});
+        write(nnue::L2_DIMS, -127, 127, int8_t{});
+    }
+
+    /// Plays random moves, null moves and takebacks with a random network, and checks the
+    /// incrementally updated accumulators against accumulators built from scratch.
+    void nnue_suite() {
+        constexpr std::array<const char*, 4> fens = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+        };
+
+        std::mt19937 rng(2024);
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "nnue_suite.nnue";
+        write_random_network(path, rng);
+        bool loaded = nnue::load(path);
+        std::filesystem::remove(path);
+        if (!loaded) {
+            std::println("info string nnue suite could not load the test network");
+            return;
+        }
+
+        long checked = 0, mismatches = 0;
+        double incremental_ns = 0, refresh_ns = 0;
+        for (const char* fen : fens) {
+            for (int game = 0; game < 25; ++game) {
+                test_board = Board(fen);
+                for (int ply = 0; ply < max_ply - 8; ++ply) {
+                    auto start = std::chrono::steady_clock::now();
+                    Score incremental = test_board.eval_nnue();
+                    auto mid = std::chrono::steady_clock::now();
+                    nnue::Accumulator fresh;
+                    nnue::refresh(fresh, test_board.state, white);
+                    nnue::refresh(fresh, test_board.state, black);
+                    Score expected = nnue::evaluate(fresh, test_board.state.side_to_move);
+                    auto end = std::chrono::steady_clock::now();
+                    incremental_ns += std::chrono::duration<double, std::nano>(mid - start).count();
+                    refresh_ns += std::chrono::duration<double, std::nano>(end - mid).count();
+
+                    checked++;
+                    if (incremental != expected && mismatches++ < 5)
+                        std::println("FAIL {} ply {} incremental {} expected {}", fen, ply, incremental, expected);
+
+                    test_board.generate_moves<ALLMOVES>();
+                    if (test_board.state.move_list.is_empty()) break;
+
+                    // Take back a move now and then, the accumulator below must still be valid.
+                    int roll = rng() % 16;
+                    if (roll == 0 && ply > 0) {
+                        test_board.unmake_last_move();
+                        ply -= 2;
+                    } else if (roll == 1 && !test_board.state.is_in_check) {
+                        test_board.make_null_move();
+                    } else {
+                        test_board.make_move(test_board.state.move_list[rng() % test_board.state.move_list.size()]);
+                    }
+                }
+            }
+        }
+
+        std::println("info string nnue suite checked {} positions, {} mismatches", checked, mismatches);
+        std::println("info string nnue eval {:.0f} ns incremental, {:.0f} ns from scratch",
+            incremental_ns / checked, refresh_ns / checked);
+
+        // Restore the configured network, or the classical evaluation if there is none.
+        nnue::load(nnue_path);
+    }
+
+    /// Measures the cycles of each evaluation term over positions of random games from the bench positions,
+    /// with the time stamp counter. The PSQT is kept incrementally during search, its cost here is that of a full recount.
+    void eval_cost() {
+        constexpr int REPEATS = 32;
+        constexpr std::array<const char*, 8> names = {
+            "psqt", "pawns", "rooks", "attacks", "mobility", "king_safety", "threats", "eval"
+        };
+
+        std::mt19937 rng(2024);
+        std::array<uint64_t, names.size()> cycles{};
+        long positions = 0, sink = 0;
+        auto time = [&](size_t term, auto&& fn) {
+            uint64_t start = __rdtsc();
+            for (int i = 0; i < REPEATS; ++i) sink += fn();
+            cycles[term] += __rdtsc() - start;
+        };
+
+        for (const char* fen : bench_fens) {
+            for (int game = 0; game < 8; ++game) {
+                test_board = Board(fen);
+                for (int ply = 0; ply < max_ply - 8; ++ply) {
+                    const PawnEntry& pawn_entry = test_board.eval_pawns();
+                    AttackInfo attacks = compute_attacks(test_board.state);
+
+                    time(0, [&] { return test_board.eval_psqt().mg; });
+                    time(1, [&] { return test_board.eval_pawns().score.mg; });
+                    time(2, [&] { return test_board.eval_rooks(pawn_entry).mg; });
+                    time(3, [&] { return bb_math::pop_count(compute_attacks(test_board.state).by_side[white]); });
+                    time(4, [&] { return test_board.eval_mobility(attacks).mg; });
+                    time(5, [&] { return test_board.eval_king_safety(attacks).mg; });
+                    time(6, [&] { return test_board.eval_threats(attacks).mg; });
+                    time(7, [&] { return test_board.eval(); });
+                    positions++;
+
+                    test_board.generate_moves<ALLMOVES>();
+                    if (test_board.state.move_list.is_empty()) break;
+                    test_board.make_move(test_board.state.move_list[rng() % test_board.state.move_list.size()]);
+                }
+            }
+        }
+
+        // Shares are of the terms' total, the last entry is the whole of Board::eval.
+        size_t eval_term = names.size() - 1;
+        double terms_cycles = 0;
+        for (size_t term = 0; term < eval_term; ++term) terms_cycles += cycles[term];
+
+        std::println("info string evalcost positions {} evaluation {} checksum {}", positions,
+            nnue::is_enabled() ? "nnue" : "classical", sink);
+        for (size_t term = 0; term < eval_term; ++term)
+            std::println("info string evalcost {} cycles {:.1f} share {:.1f}%", names[term],
+                double(cycles[term]) / (positions * REPEATS), 100.0 * cycles[term] / terms_cycles);
+        std::println("info string evalcost eval cycles {:.1f}", double(cycles[eval_term]) / (positions * REPEATS));
+    }
+
+    /// Prints the classical terms of board by colour and phase, then their cost over the bench positions.
+    void eval_trace(Board& board) {
+        EvalTrace trace = board.trace_eval();
+        std::println("info string evaltrace {:<12} {:>6} {:>6} {:>6} {:>6} {:>6} {:>6}",
+            "term", "w_mg", "w_eg", "b_mg", "b_eg", "mg", "eg");
+
+        auto print_row = [](const char* name, PhaseScore w, PhaseScore b) {
+            PhaseScore diff = w - b;
+            std::println("info string evaltrace {:<12} {:>6} {:>6} {:>6} {:>6} {:>6} {:>6}",
+                name, w.mg, w.eg, b.mg, b.eg, diff.mg, diff.eg);
+        };
+
+        PhaseScore white_total, black_total;
+        for (int term = 0; term < EvalTrace::NUM_TERMS; ++term) {
+            print_row(EvalTrace::names[term], trace.terms[term][white], trace.terms[term][black]);
+            white_total += trace.terms[term][white];
+            black_total += trace.terms[term][black];
+        }
+        print_row("total", white_total, black_total);
+
+        PhaseScore total = white_total - black_total;
+        int eg = total.eg * trace.scale / SCALE_NORMAL;
+        Score tapered = (total.mg * trace.phase + eg * (MAX_PHASE - trace.phase)) / MAX_PHASE;
+        std::println("info string evaltrace phase {}/{} scale {}/{} tapered {} eval {} (white's view)",
+            trace.phase, MAX_PHASE, trace.scale, SCALE_NORMAL, tapered, trace.score);
+        if (trace.source != EvalTrace::TERMS)
+            std::println("info string evaltrace the score comes from {}, not these terms",
+                EvalTrace::source_names[trace.source]);
+
+        eval_cost();
+    }
 }
@@ -2,6 +2,7 @@
 #include <cassert>
 
 #include "../include/transposition.hpp"
+#include "../include/profiler.hpp"
 
 void Transposition::init(std::size_t size) {
     if (transposition_tt) {
@@ -39,7 +40,8 @@ void Transposition::clear_tt() {
         std::fill_n(transposition_tt, transposition_size, TranspositionEntry{});
 }
 
-TranspositionEntry* Transposition::probe(Key key, int depth) {
+TranspositionEntry* Transposition::probe(Key key) {
+    PROFILE_SCOPE(TT_PROBE);
     if (!transposition_tt || transposition_size == 0)
         return nullptr;
     
@@ -48,22 +50,33 @@ TranspositionEntry* Transposition::probe(Key key, int depth) {
 
     assert(index < transposition_size);
 
-    if (entry->key == key && entry->depth >= depth)
+    if (entry->key == key)
+        return entry;
+    return nullptr;
+}
+
+TranspositionEntry* Transposition::probe(Key key, int depth) {
+    TranspositionEntry *entry = probe(key);
+
+    if (entry != nullptr && entry->depth >= depth)
         return entry;
     return nullptr;
 }
 
 void Transposition::store_entry(TranspositionEntry& entry) {
+    PROFILE_SCOPE(TT_STORE);
     if (!transposition_tt || transposition_size == 0)
         return;
 
     int index = entry.key & (transposition_size - 1);
     TranspositionEntry *table_entry = &transposition_tt[index];
 
-    // Depth preferred and ageing replacement strategy.
-    if (table_entry->key == 0 || 
-        (table_entry->key == entry.key && 
-            (table_entry->depth <= entry.depth && table_entry->age < entry.age)))
+    entry.age = age;
+
+    // Depth preferred and ageing replacement strategy: entries of earlier searches are always replaced,
+    // entries of this search by a result for the same position at least as deep.
+    if (table_entry->key == 0 || table_entry->age < entry.age ||
+        (table_entry->key == entry.key && table_entry->depth <= entry.depth))
         *table_entry = entry;
 }
 
@@ -78,4 +91,15 @@ float Transposition::usage() const {
     }
 
     return 100.0f * occupied / transposition_size;
-}
\ No newline at end of file
+}
+
+int Transposition::hashfull() const {
+    size_t sample = std::min<size_t>(transposition_size, 1000);
+    if (!transposition_tt || sample == 0) return 0;
+
+    int occupied = 0;
+    for (size_t i = 0; i < sample; ++i)
+        occupied += transposition_tt[i].key != 0;
+
+    return static_cast<int>(occupied * 1000 / sample);
+}
@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/tune.hpp"
+#include "../include/board.hpp"
+#include "../include/eval.hpp"
+#include "../include/material.hpp"
+#include "../include/params.hpp"
+
+using namespace bb_math;
+
+namespace {
+    // Parameter layout: material, the PSQT of each piece type p n b r q k, then the pawn, rook, mobility,
+    // king safety and threat terms.
+    constexpr int MATERIAL = 0;
+    constexpr int PSQT = 5;
+    constexpr int DBL_PAWNS = PSQT + 6 * 64;
+    constexpr int TRI_PAWNS = DBL_PAWNS + 1;
+    constexpr int PASS_PAWNS = DBL_PAWNS + 2;
+    constexpr int ISO_PAWNS = DBL_PAWNS + 3;
+    constexpr int HALF_ISO_PAWNS = DBL_PAWNS + 4;
+    constexpr int OPEN_FILE_ROOKS = DBL_PAWNS + 5;
+    constexpr int HALF_OPEN_FILE_ROOKS = DBL_PAWNS + 6;
+    constexpr int MOBILITY = DBL_PAWNS + 7; // Knight, bishop, rook and queen.
+    constexpr int KING_ZONE_ATTACKS = MOBILITY + 4;
+    constexpr int PAWN_THREATS = KING_ZONE_ATTACKS + 1;
+    constexpr int MINOR_THREATS = KING_ZONE_ATTACKS + 2;
+    constexpr int HANGING_PIECES = KING_ZONE_ATTACKS + 3;
+    constexpr int NUM_PARAMS = KING_ZONE_ATTACKS + 4;
+
+    constexpr size_t VERIFY_POSITIONS = 100000; // Positions checked against Board::eval.
+    constexpr double LEARNING_RATE = 1.0; // Centipawns per epoch at the start.
+
+    /// Middlegame and endgame value of a term. Tied terms have one value for both phases.
+    struct Param {
+        double mg = 0, eg = 0;
+        bool tied = false;
+    };
+
+    /// How often a term applies to a position, white minus black.
+    struct Coefficient {
+        uint16_t index;
+        int8_t count;
+    };
+
+    /// A position reduced to what the evaluation terms see.
+    struct Entry {
+        uint32_t begin; // First coefficient.
+        uint8_t count;
+        uint8_t phase;
+        std::array<uint8_t, 2> scale; // Endgame scale factor, indexed by the side ahead in the endgame score.
+        float result;
+    };
+
+    struct Dataset {
+        std::vector<Entry> entries;
+        std::vector<Coefficient> coefficients;
+    };
+
+    /// Runs fn(thread, begin, end) on [0, size) split evenly, each part on a new thread.
+    template <typename Fn>
+    void parallel(int threads, size_t size, const Fn& fn) {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back([&, t]() { fn(t, size * t / threads, size * (t + 1) / threads); });
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    std::vector<Param> current_params() {
+        std::vector<Param> params(NUM_PARAMS);
+        for (Piece piece = p; piece <= q; ++piece)
+            params[MATERIAL + piece] = { double(material[piece]), double(material[piece]), true };
+
+        for (Square sq = 0; sq < 64; ++sq) {
+            params[PSQT + p * 64 + sq] = { double(pawn_psqt[0][sq]), double(pawn_psqt[1][sq]) };
+            params[PSQT + n * 64 + sq] = { double(knight_psqt[sq]), double(knight_psqt[sq]), true };
+            params[PSQT + b * 64 + sq] = { double(bishop_psqt[sq]), double(bishop_psqt[sq]), true };
+            params[PSQT + r * 64 + sq] = { double(rook_psqt[sq]), double(rook_psqt[sq]), true };
+            params[PSQT + q * 64 + sq] = { double(queen_psqt[sq]), double(queen_psqt[sq]), true };
+            params[PSQT + k * 64 + sq] = { double(king_psqt[0][sq]), double(king_psqt[1][sq]) };
+        }
+
+        auto phase_score = [](PhaseScore score) { return Param{ double(score.mg), double(score.eg) }; };
+        params[DBL_PAWNS] = phase_score(DBL_PAWNS_PEN);
+        params[TRI_PAWNS] = phase_score(TRI_PAWNS_PEN);
+        params[PASS_PAWNS] = phase_score(PASS_PAWNS_BONUS);
+        params[ISO_PAWNS] = phase_score(ISO_PAWNS_PEN);
+        params[HALF_ISO_PAWNS] = phase_score(HALF_ISO_PAWNS_PEN);
+        params[OPEN_FILE_ROOKS] = phase_score(OPEN_FILE_ROOKS_BONUS);
+        params[HALF_OPEN_FILE_ROOKS] = phase_score(HALF_OPEN_FILE_ROOKS_BONUS);
+        params[MOBILITY] = phase_score(KNIGHT_MOBILITY_BONUS);
+        params[MOBILITY + 1] = phase_score(BISHOP_MOBILITY_BONUS);
+        params[MOBILITY + 2] = phase_score(ROOK_MOBILITY_BONUS);
+        params[MOBILITY + 3] = phase_score(QUEEN_MOBILITY_BONUS);
+        params[KING_ZONE_ATTACKS] = phase_score(KING_ZONE_ATTACK_BONUS);
+        params[PAWN_THREATS] = phase_score(PAWN_THREAT_BONUS);
+        params[MINOR_THREATS] = phase_score(MINOR_THREAT_BONUS);
+        params[HANGING_PIECES] = phase_score(HANGING_PIECE_BONUS);
+        return params;
+    }
+
+    /// Counts the terms of the position, mirroring Board::eval_psqt, eval_pawns, eval_rooks, eval_mobility,
+    /// eval_king_safety and eval_threats.
+    void trace(const BoardState& state, std::array<int, NUM_PARAMS>& counts) {
+        counts.fill(0);
+        for (Piece piece = p; piece <= K; ++piece) {
+            bool is_white = piece >= P;
+            int type = piece % 6;
+            BB pieces = state.bitboards[piece];
+            while (pieces) {
+                Square sq = pop_lsb(pieces);
+                if (type != k) counts[MATERIAL + type] += is_white ? 1 : -1;
+                counts[PSQT + type * 64 + (is_white ? flip_rank(sq) : sq)] += is_white ? 1 : -1;
+            }
+        }
+
+        BB wpawns = state.bitboards[P], bpawns = state.bitboards[p];
+        BB wdoubled = wpawns & wrear_span(wpawns), bdoubled = bpawns & brear_span(bpawns);
+        counts[DBL_PAWNS] = pop_count(wdoubled) / 2 - pop_count(bdoubled) / 2;
+        wdoubled &= wpawns & wfront_span(wpawns);
+        bdoubled &= bpawns & bfront_span(bpawns);
+        counts[TRI_PAWNS] = pop_count(file_fill(wdoubled)) / 3 - pop_count(file_fill(bdoubled)) / 3;
+        counts[PASS_PAWNS] = pop_count(wpassed_pawns(wpawns, bpawns)) - pop_count(bpassed_pawns(bpawns, wpawns));
+        counts[ISO_PAWNS] = pop_count(isolanis(wpawns)) - pop_count(isolanis(bpawns));
+        counts[HALF_ISO_PAWNS] = pop_count(half_isolanis(wpawns)) - pop_count(half_isolanis(bpawns));
+
+        BB wrooks = state.bitboards[R], brooks = state.bitboards[r];
+        BB open = open_file(wpawns, bpawns);
+        counts[OPEN_FILE_ROOKS] = pop_count(open & wrooks) - pop_count(open & brooks);
+        counts[HALF_OPEN_FILE_ROOKS] = pop_count(w_half_open_files(wpawns, bpawns) & wrooks)
+                                     - pop_count(b_half_open_files(wpawns, bpawns) & brooks);
+
+        AttackInfo attacks = compute_attacks(state);
+        for (int type = 0; type < 4; ++type)
+            counts[MOBILITY + type] = attacks.mobility[white][type] - attacks.mobility[black][type];
+        counts[KING_ZONE_ATTACKS] = attacks.king_zone_attacks[white] - attacks.king_zone_attacks[black];
+
+        for (Colour us : { black, white }) {
+            Piece ours = us == white ? P : p;
+            Piece theirs = us == white ? p : P;
+            BB their_pieces = state.bitboards[theirs + n] | state.bitboards[theirs + b]
+                            | state.bitboards[theirs + r] | state.bitboards[theirs + q];
+            BB their_majors = state.bitboards[theirs + r] | state.bitboards[theirs + q];
+            int sign = us == white ? 1 : -1;
+
+            counts[PAWN_THREATS] += sign * pop_count(attacks.by_piece[ours + p] & their_pieces);
+            counts[MINOR_THREATS] += sign * pop_count((attacks.by_piece[ours + n] | attacks.by_piece[ours + b]) & their_majors);
+            counts[HANGING_PIECES] += sign * pop_count(their_pieces & attacks.by_side[us] & ~attacks.by_side[us ^ 1]);
+        }
+    }
+
+    /// Result from white's view, in any of the formats the dataset may use.
+    std::optional<float> parse_result(const std::string& line) {
+        if (line.find("\"1-0\"") != std::string::npos || line.find("[1.0]") != std::string::npos) return 1.0f;
+        if (line.find("\"0-1\"") != std::string::npos || line.find("[0.0]") != std::string::npos) return 0.0f;
+        if (line.find("\"1/2-1/2\"") != std::string::npos || line.find("[0.5]") != std::string::npos) return 0.5f;
+        return std::nullopt;
+    }
+
+    /// Sets up the position of a dataset line. The counters are not needed and often missing.
+    bool load_line(Board& board, const std::string& line) { return board.load_fen(line); }
+
+    /// Endgame evaluators replace the terms being tuned, such positions are left out.
+    const MaterialEntry* tunable_material(const BoardState& state) {
+        static const MaterialEntry generic_entry;
+        bool has_lone_king = pop_count(state.bitboards[wpieces]) == 1 || pop_count(state.bitboards[bpieces]) == 1;
+        const MaterialEntry& entry = (state.phase <= phase_weights[R] || has_lone_king)
+            ? material_table.probe(state.material_key, state) : generic_entry;
+        return entry.dead_draw || entry.evaluator ? nullptr : &entry;
+    }
+
+    /// Evaluation of an entry from white's view, as Board::eval computes it without rounding.
+    double evaluate(const Entry& entry, const Coefficient* coefficients, const std::vector<Param>& params, Colour* ahead = nullptr) {
+        double mg = 0, eg = 0;
+        for (int i = 0; i < entry.count; ++i) {
+            const Coefficient& c = coefficients[entry.begin + i];
+            mg += c.count * params[c.index].mg;
+            eg += c.count * params[c.index].eg;
+        }
+
+        Colour side = eg > 0 ? white : black;
+        if (ahead) *ahead = side;
+        eg = eg * entry.scale[side] / SCALE_NORMAL;
+        return (mg * entry.phase + eg * (MAX_PHASE - entry.phase)) / MAX_PHASE;
+    }
+
+    Dataset load_dataset(const std::vector<std::string>& lines, int threads) {
+        std::vector<std::unique_ptr<Board>> boards;
+        for (int t = 0; t < threads; ++t) boards.push_back(std::make_unique<Board>());
+        std::vector<Dataset> parts(threads);
+
+        parallel(threads, lines.size(), [&](int t, size_t begin, size_t end) {
+            Board& board = *boards[t];
+            Dataset& part = parts[t];
+            std::array<int, NUM_PARAMS> counts;
+
+            for (size_t i = begin; i < end; ++i) {
+                std::optional<float> result = parse_result(lines[i]);
+                if (!result || !load_line(board, lines[i])) continue;
+
+                const MaterialEntry* material_entry = tunable_material(board.state);
+                if (!material_entry) continue;
+
+                Entry entry;
+                entry.begin = part.coefficients.size();
+                entry.phase = std::min(board.state.phase, MAX_PHASE);
+                entry.scale = { uint8_t(material_entry->scale_factor(board.state, black)),
+                                uint8_t(material_entry->scale_factor(board.state, white)) };
+                entry.result = *result;
+
+                trace(board.state, counts);
+                for (int idx = 0; idx < NUM_PARAMS; ++idx)
+                    if (counts[idx]) part.coefficients.push_back({ uint16_t(idx), int8_t(counts[idx]) });
+
+                entry.count = part.coefficients.size() - entry.begin;
+                part.entries.push_back(entry);
+            }
+        });
+
+        Dataset data;
+        for (Dataset& part : parts) {
+            uint32_t offset = data.coefficients.size();
+            for (Entry& entry : part.entries) entry.begin += offset;
+            data.entries.insert(data.entries.end(), part.entries.begin(), part.entries.end());
+            data.coefficients.insert(data.coefficients.end(), part.coefficients.begin(), part.coefficients.end());
+        }
+
+        return data;
+    }
+
+    /// Checks the traced evaluation of the first positions against Board::eval.
+    /// @return Positions whose evaluations differ by more than the rounding of Board::eval.
+    long verify(const std::vector<std::string>& lines, const std::vector<Param>& params, int threads, long& checked) {
+        std::vector<std::string> sample(lines.begin(), lines.begin() + std::min(lines.size(), VERIFY_POSITIONS));
+        Dataset data = load_dataset(sample, threads);
+
+        Board board;
+        long mismatches = 0;
+        checked = 0;
+        for (size_t i = 0, entry = 0; i < sample.size() && entry < data.entries.size(); ++i) {
+            if (!parse_result(sample[i]) || !load_line(board, sample[i]) || !tunable_material(board.state)) continue;
+
+            Score score = board.eval();
+            if (board.state.side_to_move == black) score = -score;
+            double traced = evaluate(data.entries[entry++], data.coefficients.data(), params);
+            mismatches += std::abs(traced - score) > 2;
+            checked++;
+        }
+
+        return mismatches;
+    }
+
+    double sigmoid(double k, double score) { return 1.0 / (1.0 + std::pow(10.0, -k * score / 400.0)); }
+
+    double loss(const Dataset& data, const std::vector<Param>& params, double k, int threads) {
+        std::vector<double> sums(threads);
+        parallel(threads, data.entries.size(), [&](int t, size_t begin, size_t end) {
+            double sum = 0;
+            for (size_t i = begin; i < end; ++i) {
+                const Entry& entry = data.entries[i];
+                double error = entry.result - sigmoid(k, evaluate(entry, data.coefficients.data(), params));
+                sum += error * error;
+            }
+            sums[t] = sum;
+        });
+
+        double total = 0;
+        for (double sum : sums) total += sum;
+        return total / data.entries.size();
+    }
+
+    /// Scaling constant of the sigmoid that best fits the current evaluation, by golden section search.
+    double fit_k(const Dataset& data, const std::vector<Param>& params, int threads) {
+        const double ratio = (std::sqrt(5.0) - 1) / 2;
+        double lo = 0.1, hi = 4.0;
+        for (int i = 0; i < 30; ++i) {
+            double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+            if (loss(data, params, a, threads) < loss(data, params, b, threads)) hi = b;
+            else lo = a;
+        }
+
+        return (lo + hi) / 2;
+    }
+
+    /// Gradient of the loss for the middlegame and endgame value of every term, [2 * idx + phase].
+    std::vector<double> gradient(const Dataset& data, const std::vector<Param>& params, double k, int threads) {
+        std::vector<std::vector<double>> parts(threads, std::vector<double>(2 * NUM_PARAMS));
+        parallel(threads, data.entries.size(), [&](int t, size_t begin, size_t end) {
+            std::vector<double>& grad = parts[t];
+            for (size_t i = begin; i < end; ++i) {
+                const Entry& entry = data.entries[i];
+                Colour ahead;
+                double s = sigmoid(k, evaluate(entry, data.coefficients.data(), params, &ahead));
+                double d_score = (s - entry.result) * s * (1 - s);
+                double d_mg = d_score * entry.phase / MAX_PHASE;
+                double d_eg = d_score * (MAX_PHASE - entry.phase) / MAX_PHASE * entry.scale[ahead] / SCALE_NORMAL;
+
+                for (int j = 0; j < entry.count; ++j) {
+                    const Coefficient& c = data.coefficients[entry.begin + j];
+                    grad[2 * c.index] += c.count * d_mg;
+                    grad[2 * c.index + 1] += c.count * d_eg;
+                }
+            }
+        });
+
+        // Constant factors of the derivative are left to the step size of Adam.
+        std::vector<double> grad(2 * NUM_PARAMS);
+        for (const std::vector<double>& part : parts)
+            for (int i = 0; i < 2 * NUM_PARAMS; ++i) grad[i] += part[i];
+
+        return grad;
+    }
+
+    /// Adam over the terms, tied terms move their middlegame and endgame values together.
+    void optimise(const Dataset& data, std::vector<Param>& params, double k, int epochs, int threads) {
+        constexpr double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+        std::vector<double> m(2 * NUM_PARAMS), v(2 * NUM_PARAMS);
+        auto start = std::chrono::steady_clock::now();
+
+        for (int epoch = 1; epoch <= epochs; ++epoch) {
+            std::vector<double> grad = gradient(data, params, k, threads);
+            for (int idx = 0; idx < NUM_PARAMS; ++idx) {
+                if (params[idx].tied) {
+                    grad[2 * idx] += grad[2 * idx + 1];
+                    grad[2 * idx + 1] = grad[2 * idx];
+                }
+
+                for (int phase = 0; phase < 2; ++phase) {
+                    int i = 2 * idx + phase;
+                    m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+                    v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+                    double m_hat = m[i] / (1 - std::pow(beta1, epoch));
+                    double v_hat = v[i] / (1 - std::pow(beta2, epoch));
+                    (phase == 0 ? params[idx].mg : params[idx].eg) -= LEARNING_RATE * m_hat / (std::sqrt(v_hat) + epsilon);
+                }
+            }
+
+            if (epoch % 25 == 0 || epoch == epochs) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+                std::println("info string epoch {} loss {:.6f} time {}ms", epoch, loss(data, params, k, threads), elapsed.count());
+            }
+        }
+    }
+
+    std::string format_row(const std::vector<Param>& params, int begin, bool eg, int indent, bool last) {
+        std::string row(indent, ' ');
+        for (int i = 0; i < 8; ++i) {
+            const Param& param = params[begin + i];
+            row += std::format("{:>3}", int(std::lround(eg ? param.eg : param.mg)));
+            if (i < 7 || !last) row += ",";
+        }
+        return row + "\n";
+    }
+
+    std::string format_table(const std::vector<Param>& params, int begin, bool eg, int indent) {
+        std::string table;
+        for (int rank = 0; rank < 8; ++rank)
+            table += format_row(params, begin + rank * 8, eg, indent, rank == 7);
+        return table;
+    }
+
+    /// Writes the terms in the layout of eval_params.hpp.
+    bool write_params(const std::filesystem::path& path, const std::vector<Param>& params) {
+        auto value = [&](int idx, bool eg = false) { return int(std::lround(eg ? params[idx].eg : params[idx].mg)); };
+        auto phase_score = [&](const char* name, int idx) {
+            return std::format("EVAL_PARAM PhaseScore {} = {{ {}, {} }};\n", name, value(idx), value(idx, true));
+        };
+        auto single_table = [&](const char* name, Piece type) {
+            return std::format("EVAL_PARAM std::array<Score, 64> {} = {{\n{}}};\n\n", name,
+                format_table(params, PSQT + type * 64, false, 4));
+        };
+        auto phased_table = [&](const char* name, Piece type) {
+            return std::format("EVAL_PARAM std::array<std::array<Score, 64>, 2> {} = {{{{\n    {{\n{}    }},\n    {{\n{}    }}\n}}}};\n\n",
+                name, format_table(params, PSQT + type * 64, false, 8), format_table(params, PSQT + type * 64, true, 8));
+        };
+
+        std::string out = "#ifndef EVAL_PARAMS_HPP_INCLUDE\n#define EVAL_PARAMS_HPP_INCLUDE\n\n"
+                          "#include <array>\n\n#include \"globals.hpp\"\n\n"
+                          "// Tunable evaluation terms, included by eval.hpp. Regenerated by `Engine tune`.\n\n"
+                          "// Evaluation terms as (mg, eg) pairs, interpolated by the game phase.\n";
+        out += phase_score("DBL_PAWNS_PEN", DBL_PAWNS);
+        out += phase_score("TRI_PAWNS_PEN", TRI_PAWNS);
+        out += phase_score("PASS_PAWNS_BONUS", PASS_PAWNS);
+        out += phase_score("ISO_PAWNS_PEN", ISO_PAWNS);
+        out += phase_score("HALF_ISO_PAWNS_PEN", HALF_ISO_PAWNS);
+        out += "\n";
+        out += phase_score("OPEN_FILE_ROOKS_BONUS", OPEN_FILE_ROOKS);
+        out += phase_score("HALF_OPEN_FILE_ROOKS_BONUS", HALF_OPEN_FILE_ROOKS);
+        out += "\n";
+        out += phase_score("KNIGHT_MOBILITY_BONUS", MOBILITY);
+        out += phase_score("BISHOP_MOBILITY_BONUS", MOBILITY + 1);
+        out += phase_score("ROOK_MOBILITY_BONUS", MOBILITY + 2);
+        out += phase_score("QUEEN_MOBILITY_BONUS", MOBILITY + 3);
+        out += "\n";
+        out += phase_score("KING_ZONE_ATTACK_BONUS", KING_ZONE_ATTACKS);
+        out += "\n";
+        out += phase_score("PAWN_THREAT_BONUS", PAWN_THREATS);
+        out += phase_score("MINOR_THREAT_BONUS", MINOR_THREATS);
+        out += phase_score("HANGING_PIECE_BONUS", HANGING_PIECES);
+        out += std::format("\nEVAL_PARAM std::array<Score, 5> material = {{ {}, {}, {}, {}, {} }};\n\n",
+            value(MATERIAL + p), value(MATERIAL + n), value(MATERIAL + b), value(MATERIAL + r), value(MATERIAL + q));
+        out += phased_table("pawn_psqt", p);
+        out += single_table("knight_psqt", n);
+        out += single_table("bishop_psqt", b);
+        out += single_table("rook_psqt", r);
+        out += single_table("queen_psqt", q);
+        out += phased_table("king_psqt", k);
+        out += "#endif\n";
+
+        std::ofstream file(path);
+        file << out;
+        return bool(file);
+    }
+
+#ifdef ENGINE_TUNE
+    /// Makes the evaluator use the rounded terms.
+    void apply_params(const std::vector<Param>& params) {
+        auto value = [&](int idx, bool eg = false) { return Score(std::lround(eg ? params[idx].eg : params[idx].mg)); };
+        auto phase_score = [&](int idx) { return PhaseScore{ value(idx), value(idx, true) }; };
+
+        for (Piece piece = p; piece <= q; ++piece) material[piece] = value(MATERIAL + piece);
+        for (Square sq = 0; sq < 64; ++sq) {
+            pawn_psqt[0][sq] = value(PSQT + p * 64 + sq);
+            pawn_psqt[1][sq] = value(PSQT + p * 64 + sq, true);
+            knight_psqt[sq] = value(PSQT + n * 64 + sq);
+            bishop_psqt[sq] = value(PSQT + b * 64 + sq);
+            rook_psqt[sq] = value(PSQT + r * 64 + sq);
+            queen_psqt[sq] = value(PSQT + q * 64 + sq);
+            king_psqt[0][sq] = value(PSQT + k * 64 + sq);
+            king_psqt[1][sq] = value(PSQT + k * 64 + sq, true);
+        }
+
+        DBL_PAWNS_PEN = phase_score(DBL_PAWNS);
+        TRI_PAWNS_PEN = phase_score(TRI_PAWNS);
+        PASS_PAWNS_BONUS = phase_score(PASS_PAWNS);
+        ISO_PAWNS_PEN = phase_score(ISO_PAWNS);
+        HALF_ISO_PAWNS_PEN = phase_score(HALF_ISO_PAWNS);
+        OPEN_FILE_ROOKS_BONUS = phase_score(OPEN_FILE_ROOKS);
+        HALF_OPEN_FILE_ROOKS_BONUS = phase_score(HALF_OPEN_FILE_ROOKS);
+        KNIGHT_MOBILITY_BONUS = phase_score(MOBILITY);
+        BISHOP_MOBILITY_BONUS = phase_score(MOBILITY + 1);
+        ROOK_MOBILITY_BONUS = phase_score(MOBILITY + 2);
+        QUEEN_MOBILITY_BONUS = phase_score(MOBILITY + 3);
+        KING_ZONE_ATTACK_BONUS = phase_score(KING_ZONE_ATTACKS);
+        PAWN_THREAT_BONUS = phase_score(PAWN_THREATS);
+        MINOR_THREAT_BONUS = phase_score(MINOR_THREATS);
+        HANGING_PIECE_BONUS = phase_score(HANGING_PIECES);
+        params::rebuild_eval();
+    }
+#endif
+}
+
+bool tuner::tune(const std::filesystem::path& dataset, int threads, int epochs) {
+    std::ifstream file(dataset);
+    if (!file) {
+        std::println("info string cannot open {}", dataset.string());
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) lines.push_back(std::move(line));
+
+    Dataset data = load_dataset(lines, threads);
+    if (data.entries.empty()) {
+        std::println("info string no usable positions in {}", dataset.string());
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::println("info string loaded {} of {} positions, {} coefficients, {}ms",
+        data.entries.size(), lines.size(), data.coefficients.size(), elapsed.count());
+
+    // The traced terms must reproduce the evaluation, or the tuned values would not mean the same.
+    std::vector<Param> params = current_params();
+    long checked;
+    long mismatches = verify(lines, params, threads, checked);
+    std::println("info string traced evaluation differs from eval in {} of {} positions", mismatches, checked);
+
+    double k = fit_k(data, params, threads);
+    std::println("info string k {:.4f} loss {:.6f}", k, loss(data, params, k, threads));
+    optimise(data, params, k, epochs, threads);
+
+#ifdef ENGINE_TUNE
+    apply_params(params);
+    for (Param& param : params) param = { std::round(param.mg), std::round(param.eg), param.tied };
+    mismatches = verify(lines, params, threads, checked);
+    std::println("info string tuned evaluation differs from eval in {} of {} positions", mismatches, checked);
+#endif
+
+    std::filesystem::path out = "eval_params.hpp";
+    if (!write_params(out, params)) {
+        std::println("info string cannot write {}", out.string());
+        return false;
+    }
+
+    std::println("info string tuned terms written to {}", std::filesystem::absolute(out).string());
+    return true;
+}
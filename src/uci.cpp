@@ -1,6 +1,6 @@
+#include <charconv>
 #include <vector>
 #include <sstream>
-#include <thread>
 #include <print>
 #include <string>
 
@@ -11,10 +11,22 @@
 #include "../include/transposition.hpp"
 #include "../include/tests.hpp"
 #include "../include/book.hpp"
+#include "../include/tablebase.hpp"
+#include "../include/nnue.hpp"
+#include "../include/eval_cache.hpp"
+#include "../include/params.hpp"
+#include "../include/profiler.hpp"
+#include "../include/search_thread.hpp"
 
 bool is_board_initialised = false;
 std::size_t hash_size = (MAX_TT_SIZE_MB+MIN_TT_SIZE_MB)/2;
 
+/// @brief The thread every search runs on, started by the first use.
+static SearchThread& search_thread() {
+    static SearchThread thread;
+    return thread;
+}
+
 std::vector<std::string> get_tokens(const std::string& command) {
     std::istringstream iss(command);
     std::vector<std::string> tokens;
@@ -106,6 +118,13 @@ void send_info() {
     std::print("id name Chess Engine\nid author x4A81\n");
     std::print("option name Hash type spin default {} min {} max {}\n", 
         (MAX_TT_SIZE_MB+MIN_TT_SIZE_MB)/2, MIN_TT_SIZE_MB, MAX_TT_SIZE_MB);
+    std::println("option name TBPath type string default {}", tb_path.string());
+    std::println("option name EvalFile type string default {}", nnue_path.string());
+    std::println("option name UseNNUE type check default {}", nnue::use_nnue);
+#ifdef ENGINE_TUNE
+    std::println("option name ParamFile type string default <empty>");
+    params::print_options();
+#endif
     std::println("uciok");
 }
 
@@ -117,6 +136,7 @@ void setup_engine() {
 
 void clean() {
     stop_flag.store(true);
+    search_thread().wait();
 }
 
 void handle_go(const std::string& command) {
@@ -194,8 +214,15 @@ void handle_go(const std::string& command) {
     }
 
     stop_flag.store(false);
-    std::thread search_thread([]() { game_board.run_search(); });
-    search_thread.detach();
+    search_thread().post([]() {
+#ifdef ENGINE_PROFILE
+        profiler::reset();
+        game_board.run_search();
+        profiler::report();
+#else
+        game_board.run_search();
+#endif
+    });
 }
 
 bool handle_command(const std::string& command) {
@@ -242,6 +269,55 @@ bool handle_command(const std::string& command) {
             game_table.emplace(hash_size);
             std::println("info string Hash set to {} MB", mb);
         }
+
+        if (name == "TBPath" && !value.empty()) {
+            tb_path = value;
+            std::println("info string {} tablebases loaded from {}", tablebase::init(tb_path), value);
+        }
+
+        if (name == "EvalFile" && !value.empty()) {
+            nnue_path = value;
+            if (nnue::load(nnue_path)) std::println("info string network loaded from {}", value);
+            else std::println("info string could not load a network from {}, using the classical evaluation", value);
+        }
+
+        if (name == "UseNNUE" && !value.empty()) {
+            nnue::use_nnue = value == "true";
+            if (nnue::use_nnue && !nnue::is_loaded())
+                std::println("info string no network loaded, using the classical evaluation");
+        }
+
+        // Cached static evaluations come from the previous evaluator, in this thread and the search thread.
+        if (name == "EvalFile" || name == "UseNNUE") {
+            eval_cache.clear();
+            search_thread().post([]() { eval_cache.clear(); });
+            if (game_table.has_value()) game_table->clear_tt();
+        }
+
+#ifdef ENGINE_TUNE
+        // Stored scores and the incremental PSQT of the game position depend on the parameters.
+        bool params_changed = false;
+        if (name == "ParamFile" && !value.empty() && value != "<empty>") {
+            int count = params::load(value);
+            if (count < 0) std::println("info string cannot open {}", value);
+            else std::println("info string {} parameters loaded from {}", count, value);
+            params_changed = count > 0;
+        } else if (params::find(name) != nullptr) {
+            int number;
+            const char* end = value.data() + value.size();
+            auto [ptr, ec] = std::from_chars(value.data(), end, number);
+            if (ec != std::errc() || ptr != end)
+                std::println("info string invalid value {} for {}", value, name);
+            else
+                params_changed = params::set(name, number);
+        }
+
+        if (params_changed) {
+            search_thread().post(params::rebuild_eval);
+            if (game_table.has_value()) game_table->clear_tt();
+            if (is_board_initialised) game_board.refresh_state();
+        }
+#endif
     }
 
     if (command.starts_with("position")) {
@@ -285,6 +361,32 @@ bool handle_command(const std::string& command) {
 
     if (command == "d") game_board.print_board();
 
+    if (command == "sliderbench") tests::slider_bench();
+
+    if (command == "kpktest") tests::kpk_suite();
+
+    if (command == "nnuetest") tests::nnue_suite();
+
+    if (command == "evalcost") tests::eval_cost();
+
+    if (command == "evaltrace") tests::eval_trace(game_board);
+
+#ifdef ENGINE_TUNE
+    if (command == "params") params::print();
+#endif
+
+    if (command.starts_with("bench")) {
+        std::vector<std::string> tokens = get_tokens(command);
+        setup_engine();
+        int depth = 7;
+        bool use_perf = false;
+        for (size_t i = 1; i < tokens.size(); ++i) {
+            if (tokens[i] == "perf") use_perf = true;
+            else depth = stoi(tokens[i]);
+        }
+        tests::bench(depth, use_perf);
+    }
+
     if (command == "eval") {
         std::println("info score cp {}",
             (game_board.state.side_to_move == white) ? game_board.eval() : -game_board.eval()
@@ -20,6 +20,7 @@ void zobrist::init_keys() {
     }
 
     side_key = dist(gen);
+    no_pawns_key = dist(gen);
 }
 
 Key zobrist::gen_pos_key(BoardState& state) {
@@ -47,5 +48,29 @@ Key zobrist::gen_pos_key(BoardState& state) {
     if (state.side_to_move == black)
         key ^= side_key;
 
+    return key;
+}
+
+Key zobrist::gen_pawn_key(BoardState& state) {
+    Key key = no_pawns_key;
+    for (Piece piece : { p, P }) {
+        BB pawns = state.bitboards[piece];
+        while (pawns) {
+            Square sq = bb_math::pop_lsb(pawns);
+            key ^= piece_keys[piece * 64 + sq];
+        }
+    }
+
+    return key;
+}
+
+Key zobrist::gen_material_key(BoardState& state) {
+    Key key = Key(0);
+
+    // The nth piece of a kind toggles the key of that piece on square n.
+    for (Piece piece = p; piece <= K; ++piece)
+        for (int count = 0; count < bb_math::pop_count(state.bitboards[piece]); ++count)
+            key ^= piece_keys[piece * 64 + count];
+
     return key;
 }
\ No newline at end of file